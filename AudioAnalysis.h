@@ -1,7 +1,7 @@
 #ifndef AudioAnalysis_H
 #define AudioAnalysis_H
 
-#include "Arduino.h"
+#include "AudioPlatform.h"
 /*
     AudioAnalysis.h
     By Shea Ivey
@@ -9,14 +9,8 @@
     https://github.com/sheaivey/ESP32-AudioInI2S
 */
 
-// arduinoFFT V2
-// See the develop branch on GitHub for the latest info and speedups.
-// https://github.com/kosme/arduinoFFT/tree/develop
-// if you are going for speed over precision uncomment the lines below.
-// #define FFT_SPEED_OVER_PRECISION
-// #define FFT_SQRT_APPROXIMATION
-
-#include <arduinoFFT.h>
+#include "RealFFT.h"
+#include "AudioProfiler.h"
 #ifndef SAMPLE_RATE
 #define SAMPLE_RATE 44100
 #endif
@@ -27,7 +21,9 @@
 #define BAND_SIZE 64
 #endif
 
-class AudioAnalysis
+// All of the analysis, working on buffers owned by AudioAnalysisT<> so one
+// firmware can run analyzers of different sizes side by side.
+class AudioAnalysisBase
 {
 public:
   enum falloff_type
@@ -38,13 +34,15 @@ public:
     EXPONENTIAL_FALLOFF = 3,
   };
 
-  AudioAnalysis();
-  AudioAnalysis(int32_t *samples, int sampleSize, int sampleRate, int bandSize);
-
   /* FFT Functions */
-  void computeFFT(int32_t *samples, int sampleSize, int sampleRate); // calculates FFT on sample data
-  float *getReal();                                                  // gets the Real values after FFT calculation
-  float *getImaginary();                                             // gets the imaginary values after FFT calculation
+  void begin(int minSampleSize = 0, int maxSampleSize = 0);          // builds the FFT of every power of two sample size from min to max up front, later size changes allocate nothing. 0 = sample capacity
+  template <typename sample_t>
+  void computeFFT(sample_t *samples, int sampleSize, int sampleRate); // calculates FFT on sample data
+  void setWindow(fft_window_t window = FFT_WINDOW_HAMMING);          // window applied before the FFT, the table is built once
+  fft_window_t getWindow();                                          // gets the current window
+  void setRunningMean(bool runningMean = true);                      // removes the DC offset of the previous frame, one pass over the samples instead of two
+  fft_t *getReal();                                                  // gets the Real values after FFT calculation
+  fft_t *getImaginary();                                             // gets the imaginary values after FFT calculation
 
   /* Band Frequency Functions */
   void setNoiseFloor(float noiseFloor);                         // threshold before sounds are registered
@@ -114,7 +112,18 @@ public:
     return _bandSize;
   }
 
+  int getSampleCapacity();   // gets the largest sample size this analyzer can hold
+  uint8_t getBandCapacity(); // gets the most bands this analyzer can hold
+
 protected:
+  AudioAnalysisBase(fft_t *real, fft_t *imag, float *bandBuffers, uint16_t *frequencyNames, uint16_t sampleCapacity, uint8_t bandCapacity);
+  void initBands(); // default eq levels and frequency offsets, once the buffers exist
+
+  template <typename sample_t>
+  static float readSampleAs(const void *samples, uint16_t index);
+  template <typename sample_t>
+  void prepSamples(sample_t *samples); // converts, removes DC and windows the samples into _real and tracks the sample min/max
+
   /* Library Settings */
   bool _isAutoLevel = false;
   bool _isClipping = false;
@@ -136,34 +145,48 @@ protected:
 
   float calculateFalloff(falloff_type falloffType, float falloffRate, float currentRate);
   float mapAndClip(float x, float in_min, float in_max, float out_min, float out_max);
+  void mapAndClip(const float *x, float *out, int length, float in_min, float in_max, float out_min, float out_max); // mapAndClip() of a whole array, branch free so the compiler can vectorize it
 
   /* FFT Variables */
-  int32_t *_samples = nullptr;
+  const void *_samples = nullptr;
+  float (*_sampleReader)(const void *samples, uint16_t index) = nullptr; // reads _samples in their own type
   int _sampleSize = SAMPLE_SIZE;
   int _sampleRate = SAMPLE_RATE;
-  float _real[SAMPLE_SIZE];
-  float _imag[SAMPLE_SIZE];
-  float _weighingFactors[SAMPLE_SIZE];
+  uint16_t _sampleCapacity;
+  fft_t *_real;
+  fft_t *_imag; // real input only has sampleSize / 2 + 1 bins
+  fft_window_t _window = FFT_WINDOW_HAMMING;
+  bool _runningMean = false;
 
   /* Band Frequency Variables */
   float _noiseFloor = 0;
   int _bandSize = BAND_SIZE;
-  float _bands[BAND_SIZE];
-  float _peaks[BAND_SIZE];
-  float _peakFallRate[BAND_SIZE];
-  float _peaksNorms[BAND_SIZE];
-  float _bandsNorms[BAND_SIZE];
-  float _bandEq[BAND_SIZE];
+  uint8_t _bandCapacity;
+  uint8_t _lastBandSize = -1;
+  float *_bands;
+  float *_peaks;
+  float *_peakFallRate;
+  float *_peaksNorms;
+  float *_bandsNorms;
+  float *_bandEq;
   float _low = 1;
   float _mid = 1;
   float _high = 1;
   bool _lowMidHighEq = false;
-  float _frequencyOffsets[BAND_SIZE];
-  uint16_t _frequencyNames[BAND_SIZE];
+  float *_frequencyOffsets;
+  uint16_t *_frequencyNames;
   void calculateFrequencyOffsets();
   uint16_t _bassMidTrebleWidths[3];
   uint16_t * getBassMidTrebleWidths();
 
+  /* Normalization Cache Variables */
+  uint32_t _generation = 1;           // bumped by computeFrequencies() and every setting that changes what the getters return
+  uint32_t _bandsNormGeneration = 0;  // _bandsNorms is valid while this matches _generation
+  uint32_t _peaksNormGeneration = 0;  // _peaksNorms is valid while this matches _generation
+  uint32_t _bassMidTrebleGeneration = 0;
+  float _bassMidTreble[6];            // bass, mid, treble, bass peak, mid peak, treble peak as the getters return them
+  void computeBassMidTreble();        // all six in one pass over getBands()/getPeaks()
+
   float _bandAvg = 0;
   float _peakAvg = 0;
   int8_t _bandMinIndex = 0;
@@ -191,56 +214,120 @@ protected:
   float _samplesMax = 1;
   float _autoLevelSamplesMaxFalloffRate; // used for auto level calculation
 
-  ArduinoFFT<float> *_FFT = nullptr;
+  RealFFTPlans<fft_t> _plans; // one FFT per sample size, _FFT points at the current one
+  RealFFT<fft_t> *_FFT = nullptr;
 };
 
-AudioAnalysis::AudioAnalysis(int32_t *samples, int sampleSize, int sampleRate, int bandSize)
+// Analyzer with buffers for up to SampleSize samples and BandSize bands.
+//   AudioAnalysisT<4096, 8> bassInfo;       // long window for the low end
+//   AudioAnalysisT<256, 16> transientInfo;  // short window for hits
+template <uint16_t SampleSize = SAMPLE_SIZE, uint8_t BandSize = BAND_SIZE>
+class AudioAnalysisT : public AudioAnalysisBase
 {
-  AudioAnalysis();
+  static_assert(SampleSize >= 4 && (SampleSize & (SampleSize - 1)) == 0, "SampleSize must be a power of two");
+  static_assert(BandSize > 0, "BandSize must be at least one band");
 
-  _samples = samples;
-  _sampleSize = sampleSize;
-  _sampleRate = sampleRate;
-  for (int i = 0; i < SAMPLE_SIZE; i++)
+public:
+  AudioAnalysisT()
+      : AudioAnalysisBase(_realBuffer, _imagBuffer, _bandBuffers, _frequencyNamesBuffer, SampleSize, BandSize)
   {
-    _real[i] = 0;
-    _imag[i] = 0;
-    //_weighingFactors[i] = 0;
+    initBands();
   }
-  for (int i = 0; i < BAND_SIZE; i++)
+
+  template <typename sample_t>
+  AudioAnalysisT(sample_t *samples, int sampleSize, int sampleRate, int bandSize)
+      : AudioAnalysisT()
   {
-    _bands[i] = 0;
-    _peaks[i] = 0;
-    _peakFallRate[i] = 0;
-    _peaksNorms[i] = 0;
-    _bandsNorms[i] = 0;
-    _bandEq[i] = 1;
-    // _frequencyOffsets[i] = 0; // gets set in setBandSize()
+    _samples = samples;
+    _sampleReader = &readSampleAs<sample_t>;
+    _sampleSize = min(sampleSize, (int)SampleSize);
+    _sampleRate = sampleRate;
+    setBandSize(bandSize);
   }
-  setBandSize(bandSize);
+
+private:
+  fft_t _realBuffer[SampleSize] = {};
+  fft_t _imagBuffer[SampleSize / 2 + 1] = {};
+  float _bandBuffers[BandSize * 7] = {}; // bands, peaks, fall rates, norms, eq and offsets
+  uint16_t _frequencyNamesBuffer[BandSize] = {};
+};
+
+typedef AudioAnalysisT<> AudioAnalysis;
+
+AudioAnalysisBase::AudioAnalysisBase(fft_t *real, fft_t *imag, float *bandBuffers, uint16_t *frequencyNames, uint16_t sampleCapacity, uint8_t bandCapacity)
+    : _plans(real, imag)
+{
+  // buffers belong to the derived class and are not constructed yet, only keep the pointers
+  _real = real;
+  _imag = imag;
+  _bands = bandBuffers;
+  _peaks = _bands + bandCapacity;
+  _peakFallRate = _peaks + bandCapacity;
+  _peaksNorms = _peakFallRate + bandCapacity;
+  _bandsNorms = _peaksNorms + bandCapacity;
+  _bandEq = _bandsNorms + bandCapacity;
+  _frequencyOffsets = _bandEq + bandCapacity;
+  _frequencyNames = frequencyNames;
+  _sampleCapacity = sampleCapacity;
+  _sampleSize = sampleCapacity;
+  _bandCapacity = bandCapacity;
+  _bandSize = bandCapacity;
 }
 
-AudioAnalysis::AudioAnalysis()
+void AudioAnalysisBase::initBands()
 {
-  _samples = nullptr;
   // set default eq levels;
-  for (int i = 0; i < _bandSize; i++)
+  for (int i = 0; i < _bandCapacity; i++)
   {
     _bandEq[i] = 1.0;
   }
   calculateFrequencyOffsets();
 }
 
-void AudioAnalysis::computeFFT(int32_t *samples, int sampleSize, int sampleRate)
+template <typename sample_t>
+float AudioAnalysisBase::readSampleAs(const void *samples, uint16_t index)
+{
+  return ((const sample_t *)samples)[index];
+}
+
+void AudioAnalysisBase::begin(int minSampleSize, int maxSampleSize)
+{
+  if (maxSampleSize <= 0 || maxSampleSize > _sampleCapacity)
+  {
+    maxSampleSize = _sampleCapacity;
+  }
+  if (minSampleSize <= 0 || minSampleSize > maxSampleSize)
+  {
+    minSampleSize = maxSampleSize;
+  }
+  _plans.begin(minSampleSize, maxSampleSize);
+}
+
+template <typename sample_t>
+void AudioAnalysisBase::computeFFT(sample_t *samples, int sampleSize, int sampleRate)
 {
+  AUDIO_PROFILE_SCOPE(AUDIO_STAGE_COMPUTE_FFT);
   _samples = samples;
-  if (_FFT == nullptr || _sampleSize != sampleSize || _sampleRate != sampleRate)
+  _sampleReader = &readSampleAs<sample_t>;
+  if (sampleSize > _sampleCapacity)
+  {
+    sampleSize = _sampleCapacity;
+  }
+  if (_FFT == nullptr || _sampleSize != sampleSize)
   {
     _sampleSize = sampleSize;
-    _sampleRate = sampleRate;
-    _FFT = new ArduinoFFT<float>(_real, _imag, _sampleSize, _sampleRate, _weighingFactors);
+    _FFT = _plans.get(_sampleSize); // only allocates for a size begin() did not plan
   }
+  _sampleRate = sampleRate;
+
+  prepSamples(samples);       /* Convert, remove DC and weigh data in one pass */
+  _FFT->compute();            /* Compute real FFT */
+  _FFT->complexToMagnitude(); /* Compute magnitudes */
+}
 
+template <typename sample_t>
+void AudioAnalysisBase::prepSamples(sample_t *samples)
+{
   if (_isAutoLevel)
   {
     // if (_samplesMax > _autoMin * 0x1FFFF)
@@ -255,38 +342,47 @@ void AudioAnalysis::computeFFT(int32_t *samples, int sampleSize, int sampleRate)
   }
 
   // prep samples for analysis
-  for (int i = 0; i < _sampleSize; i++)
+  float absMin, absMax;
+  _FFT->prepare(samples, 0, absMin, absMax);
+  if (absMax > _samplesMax)
   {
-    _real[i] = samples[i];
-    _imag[i] = 0;
-    if (abs(samples[i]) > _samplesMax)
-    {
-      _samplesMax = abs(samples[i]);
-      _autoLevelSamplesMaxFalloffRate = 0;
-    }
-    if (abs(samples[i]) < _samplesMin)
-    {
-      _samplesMin = abs(samples[i]);
-    }
+    _samplesMax = absMax;
+    _autoLevelSamplesMaxFalloffRate = 0;
+  }
+  if (absMin < _samplesMin)
+  {
+    _samplesMin = absMin;
   }
+}
+
+void AudioAnalysisBase::setWindow(fft_window_t window)
+{
+  _window = window;
+  _plans.setWindow(_window);
+}
+
+fft_window_t AudioAnalysisBase::getWindow()
+{
+  return _window;
+}
 
-  _FFT->dcRemoval();
-  _FFT->windowing(FFTWindow::Hamming, FFTDirection::Forward, false); /* Weigh data (compensated) */
-  _FFT->compute(FFTDirection::Forward);                              /* Compute FFT */
-  _FFT->complexToMagnitude();                                        /* Compute magnitudes */
+void AudioAnalysisBase::setRunningMean(bool runningMean)
+{
+  _runningMean = runningMean;
+  _plans.setRunningMean(_runningMean);
 }
 
-float *AudioAnalysis::getReal()
+fft_t *AudioAnalysisBase::getReal()
 {
   return _real;
 }
 
-float *AudioAnalysis::getImaginary()
+fft_t *AudioAnalysisBase::getImaginary()
 {
   return _imag;
 }
 
-void AudioAnalysis::setNoiseFloor(float noiseFloor)
+void AudioAnalysisBase::setNoiseFloor(float noiseFloor)
 {
   _noiseFloor = noiseFloor;
 }
@@ -298,28 +394,28 @@ float getPoint(float n1, float n2, float percent)
   return n1 + (diff * percent);
 }
 
-uint16_t * AudioAnalysis::getBassMidTrebleWidths() {
+uint16_t * AudioAnalysisBase::getBassMidTrebleWidths() {
   _bassMidTrebleWidths[0] = max(1, (_bandSize / 10)); // 40Hz < bass < 400Hz
   _bassMidTrebleWidths[1] = max(1, (int)((float)(_bandSize - _bassMidTrebleWidths[0]) / 3.5)); // 400Hz < mid < 1800Hz
   _bassMidTrebleWidths[2] = max(1, (_bandSize - _bassMidTrebleWidths[0] - _bassMidTrebleWidths[1])); // 1800Hz < treble < 17000Hz
   return _bassMidTrebleWidths;
 };
 
-void AudioAnalysis::setEqualizerLevels(float low, float mid, float high)
+void AudioAnalysisBase::setEqualizerLevels(float low, float mid, float high)
 {
   _low = low;
   _mid = mid;
   _high = high;
   _lowMidHighEq = true;
   uint16_t * widths = getBassMidTrebleWidths();
-  float xa, ya, xb, yb, x, y;
+  float ya, yb, y; // xa, xb, x wait for the curve TODO below
   // low curve
   float x1 = 0;
   float lowSize = widths[0];
   float y1 = low;
-  float x2 = lowSize / 2;
+  // float x2 = lowSize / 2;
   float y2 = low;
-  float x3 = lowSize;
+  // float x3 = lowSize;
   float y3 = (low + mid) / 2.0;
   for (int i = x1; i < lowSize; i++)
   {
@@ -340,9 +436,9 @@ void AudioAnalysis::setEqualizerLevels(float low, float mid, float high)
   x1 = lowSize;
   float midSize = widths[1];
   y1 = y3;
-  x2 = x1 + widths[0];
+  // x2 = x1 + widths[0];
   y2 = mid;
-  x3 = x1 + midSize;
+  // x3 = x1 + midSize;
   y3 = (mid + high) / 2.0;
   for (int i = x1; i < x1+midSize; i++)
   {
@@ -362,9 +458,9 @@ void AudioAnalysis::setEqualizerLevels(float low, float mid, float high)
   x1 = lowSize + midSize;
   float highSize = widths[2];
   y1 = y3;
-  x2 = x1 + highSize / 2;
+  // x2 = x1 + highSize / 2;
   y2 = high;
-  x3 = x1 + highSize;
+  // x3 = x1 + highSize;
   y3 = high;
   for (int i = x1; i < x1+highSize; i++)
   {
@@ -381,7 +477,7 @@ void AudioAnalysis::setEqualizerLevels(float low, float mid, float high)
   }
 }
 
-void AudioAnalysis::setEqualizerLevels(float *bandEq)
+void AudioAnalysisBase::setEqualizerLevels(float *bandEq)
 {
   _lowMidHighEq = false;
   // blind copy of eq percentages
@@ -390,14 +486,14 @@ void AudioAnalysis::setEqualizerLevels(float *bandEq)
   }
 }
 
-float *AudioAnalysis::getEqualizerLevels()
+float *AudioAnalysisBase::getEqualizerLevels()
 {
   return _bandEq;
 }
 
 // this look Up Table is used to normalize the buckets against each other. Visually makes the higher frequencies appear to be more equal to the lower frequencies. 
 float lut[] PROGMEM = {0.0006637301302, 0.0006793553648, 0.0006966758032, 0.0007158753602, 0.0007371579043, 0.0007607494216, 0.0007869004159, 0.0008158885684, 0.0008480216863, 0.0008836409716, 0.0009231246432, 0.0009668919541, 0.001015407642, 0.001069186866, 0.001128800673, 0.001194882066, 0.001268132722, 0.001349330446, 0.001439337425, 0.001539109388, 0.001649705751, 0.00177230087, 0.001908196507, 0.002058835652, 0.002225817851, 0.002410916183, 0.002616096095, 0.002843536264, 0.003095651737, 0.003375119574, 0.00368490727, 0.004028304269, 0.004408956893, 0.004830907057, 0.005298635188, 0.005817107803, 0.006391830243, 0.00702890513, 0.007735097169, 0.008517904978, 0.009385640709, 0.01034751831, 0.01141375137, 0.01259566156, 0.01390579885, 0.01535807478, 0.01696791017, 0.01875239887, 0.02073048926, 0.02292318547, 0.02535377038, 0.02804805287, 0.03103464187, 0.03434525011, 0.03801503091, 0.04208295139, 0.04659220631, 0.05159067664, 0.05713143806, 0.06327332449, 0.07008155284, 0.07762841548, 0.08599404787, 0.09526727952};
-void AudioAnalysis::calculateFrequencyOffsets()
+void AudioAnalysisBase::calculateFrequencyOffsets()
 {
   // lookup table 64 buckets
   float maxValue = ((float)_sampleSize / 2.0) * 0.7516249323;
@@ -411,11 +507,11 @@ void AudioAnalysis::calculateFrequencyOffsets()
   float v = 0;
   // Serial.print("Step Size: ");
   // Serial.println(stepSize);
-  for (int i = 0; i < BAND_SIZE; i++)
+  for (int i = 0; i < _bandCapacity; i++)
   {
     _frequencyOffsets[i] = 0;
   }
-  for (int i = 0; i * stepSize < 64; i++)
+  for (int i = 0; i * stepSize < 64 && i < _bandCapacity; i++)
   {
     offset = i * stepSize;
     v = 0;
@@ -445,8 +541,9 @@ void AudioAnalysis::calculateFrequencyOffsets()
   // Serial.println(total);
 }
 
-void AudioAnalysis::computeFrequencies(uint8_t bandSize)
+void AudioAnalysisBase::computeFrequencies(uint8_t bandSize)
 {
+  AUDIO_PROFILE_SCOPE(AUDIO_STAGE_FREQUENCIES);
   setBandSize(bandSize);
   if (!_samples)
   {
@@ -484,6 +581,7 @@ void AudioAnalysis::computeFrequencies(uint8_t bandSize)
   _peakMaxIndex = -1;
   _peakMinIndex = -1;
   int offset = 2; // first two values are noise
+  int bins = _sampleSize / 2 + 1; // real FFT only has bins up to sampleSize / 2
   for (int i = 0; i < _bandSize; i++)
   {
     _bands[i] = 0;
@@ -497,24 +595,27 @@ void AudioAnalysis::computeFrequencies(uint8_t bandSize)
     {
       _peaks[i] -= _peakFallRate[i]; // fall off rate
     }
-    for (int j = 0; j < ceil(_frequencyOffsets[i]); j++)
+    // bin units to value, scale down factor to prevent overflow and apply eq scaling
+    float toValue = _FFT->outputScale() * _FFT->windowScale() / (float)(0xFFFF * 0xFF) * _bandEq[i];
+    if (_frequencyOffsets[i] < 1)
+    {
+      toValue *= _frequencyOffsets[i]; // band scale down factor
+    }
+    // sum in bin units and convert once, integer only with AUDIO_FIXED_POINT
+    fft_t gate = FFTMath<fft_t>::gate(_noiseFloor / toValue);
+    fft_acc_t sum = 0;
+    for (int j = 0; j < ceil(_frequencyOffsets[i]) && offset + j < bins; j++)
     {
-      // scale down factor to prevent overflow
-      float rv = (_real[offset + j] / (float)(0xFFFF * 0xFF));
-      float iv = (_imag[offset + j] / (float)(0xFFFF * 0xFF));
       // some smoothing with imaginary numbers.
-      rv = sqrt(rv * rv + iv * iv);
-      // apply eq scaling
-      rv = rv * _bandEq[i];
-      if (_frequencyOffsets[i] < 1)
+      fft_t rv = FFTMath<fft_t>::exactMagnitude(_real[offset + j], _imag[offset + j]);
+      if (rv >= gate)
       {
-        rv *= _frequencyOffsets[i]; // band scale down factor
+        // combine band amplitudes for current band segment
+        sum += rv;
       }
-      rv = rv < _noiseFloor ? 0 : rv;
-      // combine band amplitudes for current band segment
-      _bands[i] += rv;
-      _vu += rv;
     }
+    _bands[i] = sum * toValue;
+    _vu += _bands[i];
     offset += ceil(_frequencyOffsets[i]);
 
     // remove noise
@@ -598,9 +699,10 @@ void AudioAnalysis::computeFrequencies(uint8_t bandSize)
   {
     _vuPeakMin = _vuPeak;
   }
+  _generation++; // normalized getters calculate again on first use
 }
 
-float AudioAnalysis::mapAndClip(float x, float in_min, float in_max, float out_min, float out_max)
+float AudioAnalysisBase::mapAndClip(float x, float in_min, float in_max, float out_min, float out_max)
 {
   if (_isAutoLevel && _autoMax != -1 && x > _autoMax)
   {
@@ -620,31 +722,47 @@ float AudioAnalysis::mapAndClip(float x, float in_min, float in_max, float out_m
   return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
 }
 
-void AudioAnalysis::normalize(bool normalize, float min, float max)
+void AudioAnalysisBase::mapAndClip(const float *x, float *out, int length, float in_min, float in_max, float out_min, float out_max)
+{
+  // same result as mapAndClip() for every value, clipping to _autoMax becomes a select against infinity when it is off
+  float autoMax = _isAutoLevel && _autoMax != -1 ? _autoMax : INFINITY;
+  float outRange = out_max - out_min;
+  float inRange = in_max - in_min;
+  for (int i = 0; i < length; i++)
+  {
+    float v = x[i] < in_min ? in_min : x[i];
+    v = x[i] > in_max ? in_max : v;
+    v = x[i] > autoMax ? autoMax : v;
+    out[i] = (v - in_min) * outRange / inRange + out_min;
+  }
+}
+
+void AudioAnalysisBase::normalize(bool normalize, float min, float max)
 {
   _isNormalize = normalize;
   _normalMin = min;
   _normalMax = max;
+  _generation++;
 }
-void AudioAnalysis::bandPeakFalloff(falloff_type falloffType, float falloffRate)
+void AudioAnalysisBase::bandPeakFalloff(falloff_type falloffType, float falloffRate)
 {
   _bandPeakFalloffType = falloffType;
   _bandPeakFalloffRate = falloffRate;
 }
 
-void AudioAnalysis::vuPeakFalloff(falloff_type falloffType, float falloffRate)
+void AudioAnalysisBase::vuPeakFalloff(falloff_type falloffType, float falloffRate)
 {
   _vuPeakFalloffType = falloffType;
   _vuPeakFalloffRate = falloffRate;
 }
 
-void AudioAnalysis::samplesFalloff(falloff_type falloffType, float falloffRate)
+void AudioAnalysisBase::samplesFalloff(falloff_type falloffType, float falloffRate)
 {
   _sampleLevelFalloffType = falloffType;
   _sampleLevelFalloffRate = falloffRate;
 }
 
-float AudioAnalysis::calculateFalloff(falloff_type falloffType, float falloffRate, float currentRate)
+float AudioAnalysisBase::calculateFalloff(falloff_type falloffType, float falloffRate, float currentRate)
 {
   switch (falloffType)
   {
@@ -664,96 +782,103 @@ float AudioAnalysis::calculateFalloff(falloff_type falloffType, float falloffRat
   }
 }
 
-void AudioAnalysis::autoLevel(falloff_type falloffType, float falloffRate, float min, float max)
+void AudioAnalysisBase::autoLevel(falloff_type falloffType, float falloffRate, float min, float max)
 {
   _isAutoLevel = falloffType != NO_FALLOFF;
   _autoLevelFalloffType = falloffType;
   _autoLevelFalloffRate = falloffRate;
   _autoMin = min;
   _autoMax = max;
+  _generation++;
 }
 
-bool AudioAnalysis::isNormalize()
+bool AudioAnalysisBase::isNormalize()
 {
   return _isNormalize;
 }
 
-bool AudioAnalysis::isAutoLevel()
+bool AudioAnalysisBase::isAutoLevel()
 {
   return _isAutoLevel;
 }
 
-bool AudioAnalysis::isClipping()
+bool AudioAnalysisBase::isClipping()
 {
   return _isClipping;
 }
 
-int AudioAnalysis::getBandSize() {
+int AudioAnalysisBase::getBandSize() {
   return _bandSize;
 }
 
-void AudioAnalysis::setBandSize(uint8_t bandSize)
+int AudioAnalysisBase::getSampleCapacity()
+{
+  return _sampleCapacity;
+}
+
+uint8_t AudioAnalysisBase::getBandCapacity()
+{
+  return _bandCapacity;
+}
+
+void AudioAnalysisBase::setBandSize(uint8_t bandSize)
 {
-  static uint8_t lastBandSize = -1;
-  if (bandSize > 0 && bandSize <= BAND_SIZE)
+  if (bandSize == 0 || bandSize > _bandCapacity)
   {
-    if (lastBandSize != bandSize)
-    { // changed size
-      _bandSize = bandSize;
-      calculateFrequencyOffsets();
-      if (_lowMidHighEq) 
-      {
-        setEqualizerLevels(_low, _mid, _high); // set the equlizer offsets
-      }
-    }
+    bandSize = _bandCapacity;
   }
-  else {
-    _bandSize = BAND_SIZE;
+  if (_lastBandSize != bandSize)
+  { // changed size
+    _bandSize = bandSize;
+    calculateFrequencyOffsets();
+    if (_lowMidHighEq) 
+    {
+      setEqualizerLevels(_low, _mid, _high); // set the equlizer offsets
+    }
+    _generation++;
   }
-  lastBandSize = _bandSize;
+  _lastBandSize = _bandSize;
 }
 
-float *AudioAnalysis::getBands()
+float *AudioAnalysisBase::getBands()
 {
   if (_isNormalize)
   {
-    for (int i = 0; i < _bandSize; i++)
+    if (_bandsNormGeneration != _generation)
     {
-      _bandsNorms[i] = mapAndClip(_bands[i], 0.0f, _autoLevelPeakMax, _normalMin, _normalMax);
+      // once per computeFrequencies(), every getter after that reads the same array
+      mapAndClip(_bands, _bandsNorms, _bandSize, 0.0f, _autoLevelPeakMax, _normalMin, _normalMax);
+      _bandsNormGeneration = _generation;
     }
     return _bandsNorms;
   }
   return _bands;
 }
 
-uint16_t *AudioAnalysis::getBandNames()
+uint16_t *AudioAnalysisBase::getBandNames()
 {
   return _frequencyNames;
 }
 
-uint16_t AudioAnalysis::getBandName(uint8_t index)
+uint16_t AudioAnalysisBase::getBandName(uint8_t index)
 {
-  if (index >= _bandSize || index < 0)
+  if (index >= _bandSize)
   {
     return 0;
   }
   return _frequencyNames[index];
 }
 
-float AudioAnalysis::getBand(uint8_t index)
+float AudioAnalysisBase::getBand(uint8_t index)
 {
-  if (index >= _bandSize || index < 0)
+  if (index >= _bandSize)
   {
     return 0;
   }
-  if (_isNormalize)
-  {
-    return mapAndClip(_bands[index], 0.0f, _autoLevelPeakMax, _normalMin, _normalMax);
-  }
-  return _bands[index];
+  return getBands()[index];
 }
 
-float AudioAnalysis::getBandAvg()
+float AudioAnalysisBase::getBandAvg()
 {
   if (_isNormalize)
   {
@@ -762,48 +887,45 @@ float AudioAnalysis::getBandAvg()
   return _bandAvg;
 }
 
-float AudioAnalysis::getBandMax()
+float AudioAnalysisBase::getBandMax()
 {
   return getBand(getBandMaxIndex());
 }
 
-int AudioAnalysis::getBandMaxIndex()
+int AudioAnalysisBase::getBandMaxIndex()
 {
   return _bandMaxIndex;
 }
 
-int AudioAnalysis::getBandMinIndex()
+int AudioAnalysisBase::getBandMinIndex()
 {
   return _bandMinIndex;
 }
 
-float *AudioAnalysis::getPeaks()
+float *AudioAnalysisBase::getPeaks()
 {
   if (_isNormalize)
   {
-    for (int i = 0; i < _bandSize; i++)
+    if (_peaksNormGeneration != _generation)
     {
-      _peaksNorms[i] = mapAndClip(_peaks[i], 0.0f, _autoLevelPeakMax, _normalMin, _normalMax);
+      mapAndClip(_peaks, _peaksNorms, _bandSize, 0.0f, _autoLevelPeakMax, _normalMin, _normalMax);
+      _peaksNormGeneration = _generation;
     }
     return _peaksNorms;
   }
   return _peaks;
 }
 
-float AudioAnalysis::getPeak(uint8_t index)
+float AudioAnalysisBase::getPeak(uint8_t index)
 {
-  if (index >= _bandSize || index < 0)
+  if (index >= _bandSize)
   {
     return 0;
   }
-  if (_isNormalize)
-  {
-    return mapAndClip(_peaks[index], 0.0f, _autoLevelPeakMax, _normalMin, _normalMax);
-  }
-  return _peaks[index];
+  return getPeaks()[index];
 }
 
-float AudioAnalysis::getPeakAvg()
+float AudioAnalysisBase::getPeakAvg()
 {
   if (_isNormalize)
   {
@@ -812,131 +934,105 @@ float AudioAnalysis::getPeakAvg()
   return _peakAvg;
 }
 
-float AudioAnalysis::getPeakMax()
+float AudioAnalysisBase::getPeakMax()
 {
   return getPeak(getPeakMaxIndex());
 }
 
-int AudioAnalysis::getPeakMaxIndex()
+int AudioAnalysisBase::getPeakMaxIndex()
 {
   return _peakMaxIndex;
 }
 
-int AudioAnalysis::getPeakMinIndex()
+int AudioAnalysisBase::getPeakMinIndex()
 {
   return _peakMinIndex;
 }
 
-float AudioAnalysis::getBass()
+void AudioAnalysisBase::computeBassMidTreble()
 {
   uint16_t *widths = getBassMidTrebleWidths();
-  int start = 0;
-  int range = widths[0];
   float *bands = getBands();
-  float out = bands[start];
-  for (int i = start; i < start + range; i++)
+  float *peaks = getPeaks();
+  int start = 0;
+  for (int r = 0; r < 3; r++)
   {
-    if (out < bands[i])
+    if (start >= _bandSize)
+    {
+      // too few bands for a treble range, same as mid
+      _bassMidTreble[r] = _bassMidTreble[r - 1];
+      _bassMidTreble[r + 3] = _bassMidTreble[r + 2];
+      continue;
+    }
+    float band = bands[start];
+    float peak = peaks[start];
+    for (int i = start; i < start + widths[r]; i++)
     {
-      out = bands[i];
+      band = band < bands[i] ? bands[i] : band;
+      peak = peak < peaks[i] ? peaks[i] : peak;
     }
+    _bassMidTreble[r] = band;
+    _bassMidTreble[r + 3] = peak;
+    start += widths[r];
   }
-  return out;
+  _bassMidTrebleGeneration = _generation;
 }
 
-float AudioAnalysis::getMid()
+float AudioAnalysisBase::getBass()
 {
-  uint16_t *widths = getBassMidTrebleWidths();
-  int start = widths[0];
-  int range = widths[1];
-  float *bands = getBands();
-  float out = bands[start];
-  for (int i = start; i < start + range; i++)
+  if (_bassMidTrebleGeneration != _generation)
   {
-    if (out < bands[i])
-    {
-      out = bands[i];
-    }
+    computeBassMidTreble();
   }
-  return out;
+  return _bassMidTreble[0];
 }
 
-float AudioAnalysis::getTreble()
+float AudioAnalysisBase::getMid()
 {
-  uint16_t *widths = getBassMidTrebleWidths();
-  int start = widths[0] + widths[1];
-  if (start >= _bandSize)
+  if (_bassMidTrebleGeneration != _generation)
   {
-    return getMid();
+    computeBassMidTreble();
   }
-  int range = widths[2];
-  float *bands = getBands();
-  float out = bands[start];
-  for (int i = start; i < start + range; i++)
+  return _bassMidTreble[1];
+}
+
+float AudioAnalysisBase::getTreble()
+{
+  if (_bassMidTrebleGeneration != _generation)
   {
-    if (out < bands[i])
-    {
-      out = bands[i];
-    }
+    computeBassMidTreble();
   }
-  return out;
+  return _bassMidTreble[2];
 }
 
-float AudioAnalysis::getBassPeak()
+float AudioAnalysisBase::getBassPeak()
 {
-  uint16_t *widths = getBassMidTrebleWidths();
-  int start = 0;
-  int range = widths[0];
-  float *bands = getPeaks();
-  float out = bands[start];
-  for (int i = start; i < start + range; i++)
+  if (_bassMidTrebleGeneration != _generation)
   {
-    if (out < bands[i])
-    {
-      out = bands[i];
-    }
+    computeBassMidTreble();
   }
-  return out;
+  return _bassMidTreble[3];
 }
 
-float AudioAnalysis::getMidPeak()
+float AudioAnalysisBase::getMidPeak()
 {
-  uint16_t *widths = getBassMidTrebleWidths();
-  int start = widths[0];
-  int range = widths[1];
-  float *bands = getPeaks();
-  float out = bands[start];
-  for (int i = start; i < start + range; i++)
+  if (_bassMidTrebleGeneration != _generation)
   {
-    if (out < bands[i])
-    {
-      out = bands[i];
-    }
+    computeBassMidTreble();
   }
-  return out;
+  return _bassMidTreble[4];
 }
 
-float AudioAnalysis::getTreblePeak()
+float AudioAnalysisBase::getTreblePeak()
 {
-  uint16_t *widths = getBassMidTrebleWidths();
-  int start = widths[0] + widths[1];
-  if(start >= _bandSize) {
-    return getMidPeak();
-  }
-  int range = widths[2];
-  float *bands = getPeaks();
-  float out = bands[start];
-  for (int i = start; i < start + range; i++)
+  if (_bassMidTrebleGeneration != _generation)
   {
-    if (out < bands[i])
-    {
-      out = bands[i];
-    }
+    computeBassMidTreble();
   }
-  return out;
+  return _bassMidTreble[5];
 }
 
-float AudioAnalysis::getVolumeUnit()
+float AudioAnalysisBase::getVolumeUnit()
 {
   if (_isNormalize)
   {
@@ -945,7 +1041,7 @@ float AudioAnalysis::getVolumeUnit()
   return _vu;
 }
 
-float AudioAnalysis::getVolumeUnitPeak()
+float AudioAnalysisBase::getVolumeUnitPeak()
 {
   if (_isNormalize)
   {
@@ -954,7 +1050,7 @@ float AudioAnalysis::getVolumeUnitPeak()
   return _vuPeak;
 }
 
-float AudioAnalysis::getVolumeUnitMax()
+float AudioAnalysisBase::getVolumeUnitMax()
 {
   if (_isNormalize)
   {
@@ -963,7 +1059,7 @@ float AudioAnalysis::getVolumeUnitMax()
   return _vuMax;
 }
 
-float AudioAnalysis::getVolumeUnitPeakMax()
+float AudioAnalysisBase::getVolumeUnitPeakMax()
 {
   if (_isNormalize)
   {
@@ -972,15 +1068,14 @@ float AudioAnalysis::getVolumeUnitPeakMax()
   return _autoLevelVuPeakMax;
 }
 
-float AudioAnalysis::getSample(uint16_t index)
+float AudioAnalysisBase::getSample(uint16_t index)
 {
   float value = 0;
   if (_samples)
   {
-    value = (float)_samples[index];
-    if (index < 0 || index >= _sampleSize)
+    if (index < _sampleSize)
     {
-      value = 0; // make zero
+      value = _sampleReader(_samples, index);
     }
   }
 
@@ -992,7 +1087,7 @@ float AudioAnalysis::getSample(uint16_t index)
   return value;
 }
 
-uint16_t AudioAnalysis::getSampleTriggerIndex()
+uint16_t AudioAnalysisBase::getSampleTriggerIndex()
 {
   if (!_samples)
   {
@@ -1001,8 +1096,8 @@ uint16_t AudioAnalysis::getSampleTriggerIndex()
 #define ZERO_RANGE 0
   for (int i = 0; i < (_sampleSize/2 - 1); i++)
   {
-    float a = _samples[i];
-    float b = _samples[i + 1];
+    float a = _sampleReader(_samples, i);
+    float b = _sampleReader(_samples, i + 1);
     if (a >= ZERO_RANGE && b < -ZERO_RANGE)
     {
       return i;
@@ -1011,7 +1106,7 @@ uint16_t AudioAnalysis::getSampleTriggerIndex()
   return 0;
 }
 
-float AudioAnalysis::getSampleMin()
+float AudioAnalysisBase::getSampleMin()
 {
   if (_isNormalize)
   {
@@ -1020,7 +1115,7 @@ float AudioAnalysis::getSampleMin()
   return _samplesMin;
 }
 
-float AudioAnalysis::getSampleMax()
+float AudioAnalysisBase::getSampleMax()
 {
   if (_isNormalize)
   {
@@ -1,7 +1,7 @@
 #ifndef AudioFrequencyAnalysis_H
 #define AudioFrequencyAnalysis_H
 
-#include "Arduino.h"
+#include "AudioPlatform.h"
 #include "RollingAverage.h"
 
 /*
@@ -11,14 +11,9 @@
     https://github.com/sheaivey/ESP32-AudioInI2S
 */
 
-// arduinoFFT V2
-// See the develop branch on GitHub for the latest info and speedups.
-// https://github.com/kosme/arduinoFFT/tree/develop
-// if you are going for speed over percision uncomment the lines below.
-// #define FFT_SPEED_OVER_PRECISION
-// #define FFT_SQRT_APPROXIMATION
-
-#include <arduinoFFT.h>
+#include "RealFFT.h"
+#include "Decimator.h"
+#include "AudioProfiler.h"
 #ifndef SAMPLE_RATE
 #define SAMPLE_RATE 44100
 #endif
@@ -42,31 +37,76 @@ enum falloff_type
   ROLLING_AVERAGE_FALLOFF = 4,
 };
 
-class AudioFrequencyAnalysis;
+// spectral features calculated after every frame, or'ed together for AudioFrequencyAnalysis::setFeatures()
+enum audio_feature
+{
+  AUDIO_FEATURE_NONE = 0,
+  AUDIO_FEATURE_CENTROID = 1,       // getSpectralCentroid()
+  AUDIO_FEATURE_ROLLOFF = 2,        // getSpectralRolloff()
+  AUDIO_FEATURE_FLATNESS = 4,       // getSpectralFlatness()
+  AUDIO_FEATURE_FLUX = 8,           // getSpectralFlux()
+  AUDIO_FEATURE_ZERO_CROSSINGS = 16, // getZeroCrossingRate()
+  AUDIO_FEATURE_RMS = 32,           // getRMS() and getDBFS()
+  AUDIO_FEATURE_ALL = 63,
+};
+
+// frequency weightings of the calibrated levels, IEC 61672
+enum weighting_type
+{
+  Z_WEIGHTING = 0, // flat
+  A_WEIGHTING = 1, // hearing at low levels, the usual one for noise limits
+  C_WEIGHTING = 2, // hearing at high levels, keeps the bass
+};
+
+// calibrated level of a range or a whole analyzer, powers are mean squares relative to full scale
+struct SoundLevel
+{
+  float power = 0;   // last frame
+  float energy = 0;  // power * seconds of the running Leq period
+  float seconds = 0;
+  float leq = 0;     // mean power of the last finished Leq period
+
+  void add(float framePower, float frameSeconds, float period);
+};
+
+class AudioFrequencyAnalysisBase;
 
 class FrequencyRange
 {
 public:
 
-  AudioFrequencyAnalysis *_audioInfo = nullptr;
+  AudioFrequencyAnalysisBase *_audioInfo = nullptr;
 
   FrequencyRange(); // full 0Hz - 20000Hz range
   FrequencyRange(uint16_t lowHz, uint16_t highHz, float scaling = 1); // scaling for equalizer
+  FrequencyRange(const FrequencyRange &) = delete; // owns its rolling averages
+  FrequencyRange &operator=(const FrequencyRange &) = delete;
+  ~FrequencyRange();
 
-  void setAudioInfo(AudioFrequencyAnalysis *audioInfo);
+  void setAudioInfo(AudioFrequencyAnalysisBase *audioInfo);
+  void reindex(); // bin indices of the range for the current sample size, rate and bins of the analyzer
 
-  void loop(); // calculates the value for the current sample frame.
+  void loop(float value, int16_t maxIndex); // updates peaks and min/max with the value calculated for the current sample frame.
+  void update(float value); // loop() without a max bin, for ranges that calculate their own value
+  bool binsChanged(); // true when the analyzer bin table no longer matches the range settings or the analyzer format
 
   float getValue(); // returns the raw value
   float getValue(float min, float max); // returns the calculated value
   float getPeak(); // returns the raw peak
   float getPeak(float min, float max); // returns the calculated peak
+  float getPredictedValue(float seconds = -1); // raw value extrapolated seconds ahead from its recent slope. -1 = the analyzer latency
+  float getPredictedValue(float min, float max, float seconds = -1); // calculated value extrapolated seconds ahead
+  float loopSeconds(); // time between two loop() calls
+  float getDBFS();  // calibrated weighted level of the last frame, see AudioFrequencyAnalysis::setCalibration()
+  float getDBSPL(); // calibrated weighted sound pressure level of the last frame
+  float getLeq();   // dB SPL, energy average of the last finished Leq period
   
-  uint16_t getMaxFrequency(); // gets the max frequency in Hz within the range
+  uint16_t getMaxFrequency(); // gets the max frequency in Hz within the range, the target frequency of a GoertzelRange
   float getMin(); // gets the lowest raw value in the range
   float getMax(); // gets the highest raw value in the range
 
   float _value = 0;
+  float _slope = 0; // change of _value per loop(), smoothed
   float _peak = 0;
   float _min = 0;
   float _max = 1;
@@ -75,6 +115,7 @@ public:
   float _autoFloor = 100;
 
   float _highFrequencyRollOffCompensation = 0; // typically between 0.5 and 1.0, -1 to disable
+  SoundLevel _level; // calibrated level, unaffected by _scaling, _highFrequencyRollOffCompensation and the noise floor
 
   falloff_type _maxFalloffType = EXPONENTIAL_FALLOFF;
   float _maxFalloffRate = .000001;
@@ -91,26 +132,110 @@ public:
   boolean _inIsolation = false; // isolate the min/max to this frequency range or all ranges
   uint16_t _lowHz = 0;
   uint16_t _highHz = 20000;
-  uint16_t _startSampleIndex = 0;
-  uint16_t _endSampleIndex = SAMPLE_SIZE/2;
+  uint16_t _startSampleIndex = 0;          // first bin overlapping the range
+  uint16_t _endSampleIndex = SAMPLE_SIZE/2; // one past the last bin overlapping the range
+  float _lowBinIndex = 0;                   // range edges in fractional bins, edge bins count by how much of them is inside
+  float _highBinIndex = 0;
+  uint32_t _generation = 0;                 // analyzer _generation the indices were calculated for
+
+  bool _usesBins = true; // false for GoertzelRange, which calculates its own value
+
+  // settings the analyzer bin table was built with
+  uint16_t _tableLowHz = 0;
+  uint16_t _tableHighHz = 0;
+  float _tableRollOffCompensation = 0;
 };
 
 
-class AudioFrequencyAnalysis
+// Single frequency detector calculated sample by sample as samples arrive, no FFT needed.
+// Registered with addFrequencyRange() like any other range, when only GoertzelRanges are
+// registered the analyzer skips the FFT completely.
+class GoertzelRange : public FrequencyRange
 {
 public:
-  AudioFrequencyAnalysis();
-  AudioFrequencyAnalysis(int32_t *samples, int sampleSize, int sampleRate);
+  GoertzelRange(uint16_t hz, float bandwidthHz = 0, float scaling = 1); // bandwidth 0 = same as an FFT bin of the analyzer
+
+  void begin(int sampleRate, int sampleSize); // coefficients for the current sample rate
+  template <typename sample_t>
+  void process(sample_t *samples, int samplesLength); // runs the detector, updates the value after every block
+
+  uint16_t _hz = 0;
+  float _bandwidthHz = 0;
+  bool _hamming = false;   // Hamming window the block, less leakage from strong neighbours for about twice the work
+  int _sampleRate = 0;
+  uint16_t _blockSize = 0; // samples per value, sampleRate / bandwidth
+  uint16_t _count = 0;     // samples into the current block
+  uint8_t _shift = 0;      // input headroom so the fixed point resonator stays inside 32 bits
+  fft_t _cos = 0;          // cos / sin of the target frequency per sample
+  fft_t _sin = 0;
+  fft_t _windowStep = 0;   // cos of the Hamming window phase per sample
+  fft_t _windowCos = 0;    // cos of the window phase, for the current and the previous sample
+  fft_t _windowPrev = 0;
+  fft_t _s1 = 0; // resonator state
+  fft_t _s2 = 0;
+};
+
+// per range totals, filled during the bin pass
+struct FrequencyRangeSum
+{
+  fft_acc_t sum = 0;
+  fft_acc_t maxBin = 0;
+  int16_t maxIndex = -1;
+  fft_t gate = 0;  // noise floor in bin units
+  float scale = 0; // bin units to value, includes _scaling
+  float power = 0; // weighted squared bins for the calibrated level
+};
+
+// constant-Q kernels of one sample size, built for one sample rate
+struct ConstantQKernel
+{
+  ConstantQKernel() {}
+  ConstantQKernel(const ConstantQKernel &) = delete; // owns its entries
+  ConstantQKernel &operator=(const ConstantQKernel &) = delete;
+  ~ConstantQKernel();
+
+  int sampleRate = 0;        // rate the kernels were built for, 0 = not built
+  uint16_t bins = 0;
+  uint32_t capacity = 0;     // entries index/real/imag can hold
+  uint32_t *start = nullptr; // entries of bin k are start[k] .. start[k + 1] - 1, sampleSize / 2 + 2 values
+  uint16_t *index = nullptr; // FFT bin of each entry
+  fft_t *real = nullptr;     // conj(spectral kernel) / sampleSize of each entry
+  fft_t *imag = nullptr;
+};
+
+// All of the analysis, working on buffers owned by AudioFrequencyAnalysisT<> so one
+// firmware can run analyzers of different sizes side by side.
+class AudioFrequencyAnalysisBase
+{
+public:
+  AudioFrequencyAnalysisBase(const AudioFrequencyAnalysisBase &) = delete; // owns its tables
+  AudioFrequencyAnalysisBase &operator=(const AudioFrequencyAnalysisBase &) = delete;
+  ~AudioFrequencyAnalysisBase(); // frees the tables, ranges and the low/right analyzers belong to the caller
 
   /* FFT Functions */
-  void loop(int32_t *samples, int sampleSize, int sampleRate); // calculates FFT on sample data
+  void begin(int minSampleSize = 0, int maxSampleSize = 0); // builds the FFT of every power of two sample size from min to max up front, later size changes allocate nothing. 0 = sample capacity
+  template <typename sample_t>
+  void loop(sample_t *samples, int sampleSize, int sampleRate); // calculates FFT on sample data
+  template <typename sample_t>
+  bool stream(sample_t *samples, int samplesLength, int sampleSize, int sampleRate); // pushes new samples into the history, calculates FFT every hop. returns true when a new frame was calculated
+
+  void setHopSize(int hopSize = 0); // new samples between FFT frames when streaming. 0 = sampleSize (no overlap), sampleSize/2 = 50% overlap, sampleSize/4 = 75% overlap
+  int getHopSize();                 // gets the current hop size
+  int getFrameStep();               // new samples between the last two frames, sampleSize for loop(), the samples read since the last frame for stream()
+  int getNominalFrameStep();        // new samples between frames on average, sampleSize for loop(), the hop for stream()
 
   void addFrequencyRange(FrequencyRange *_frequencyRange);
 
-  float *getReal();       // gets the Real values after FFT calculation
-  float *getImaginary();  // gets the imaginary values after FFT calculation  
+  void setWindow(fft_window_t window = FFT_WINDOW_HAMMING); // window applied before the FFT, the table is built once
+  fft_window_t getWindow();                                 // gets the current window
+  void setRunningMean(bool runningMean = true);             // removes the DC offset of the previous frame, one pass over the samples instead of two
+
+  fft_t *getReal();       // gets the Real values after FFT calculation
+  fft_t *getImaginary();  // gets the imaginary values after FFT calculation  
   int getSampleRate();    // gets current sample rate
   int getSampleSize();    // gets current sample size
+  int getSampleCapacity(); // gets the largest sample size this analyzer can hold
+  uint8_t getRangeCapacity(); // gets the most frequency ranges this analyzer can hold
 
   /* Band Frequency Functions */
   void setNoiseFloor(float noiseFloor);                              // threshold before sounds are registered
@@ -122,6 +247,58 @@ public:
   isNormalize();      // is normalize enabled
   bool isAutoLevel(); // is auto level enabled
 
+  /* Constant-Q Functions */
+  void setConstantQ(uint8_t binsPerOctave = 12, float minHz = 55, float maxHz = 14080); // frequency ranges read log spaced bins instead of FFT bins. 0 = FFT bins
+  bool isConstantQ();                 // is constant-Q enabled
+  fft_t *getConstantQ();              // gets the constant-Q bin magnitudes after analysis
+  uint16_t getBinCount();             // bins the frequency ranges are built from, FFT or constant-Q
+  float getBinFrequency(float index); // center frequency in Hz of a bin index
+  float getBinIndex(float hz);        // bin index of a frequency in Hz
+
+  /* Multi Resolution Functions */
+  void setMultiResolution(AudioFrequencyAnalysisBase *lowInfo, uint8_t decimation = 8, int sampleSize = 0, uint16_t crossoverHz = 0); // ranges below crossoverHz are analysed by lowInfo on decimated samples. call before addFrequencyRange()
+  AudioFrequencyAnalysisBase *getLowResolution(); // gets the analyzer of the low ranges
+  uint16_t getCrossover();                        // gets the highest frequency in Hz sent to the low resolution analyzer
+
+  /* Stereo Functions */
+  void setStereo(AudioFrequencyAnalysisBase *rightInfo); // rightInfo analyses the right channel on this analyzer's FFT plans, buffers and window, an AudioFrequencyAnalysisRight has no FFT buffers of its own. call once before the first frame
+  AudioFrequencyAnalysisBase *getRightChannel();          // gets the analyzer of the right channel
+  template <typename sample_t>
+  void loop(sample_t *left, sample_t *right, int sampleSize, int sampleRate); // calculates FFT on both channels
+  template <typename sample_t>
+  bool stream(sample_t *left, sample_t *right, int samplesLength, int sampleSize, int sampleRate); // pushes new samples of both channels, returns true when a new frame was calculated
+
+  /* Governor Functions */
+  void setFrameBudget(float framesPerSecond, int minSampleSize = 256, int minSampleRate = 8000); // times every frame and picks the cheapest sample size/rate that covers the ranges and fits 1 / framesPerSecond, only the size with constant-Q. 0 = off
+  int getGovernedSampleSize(); // sample size the governor asks for, pass it to loop()/stream() and the mic reads
+  int getGovernedSampleRate(); // sample rate the governor asks for, pass it to loop()/stream() and AudioInI2S::setSampleRate()
+  float getFrameTime();        // average analysis time of the last frames in microseconds, while the governor is on
+
+  /* Latency Functions */
+  void setInputLatency(int samples);    // samples a sound waits before loop()/stream() gets it, AudioInI2S::getLatency()
+  void setOutputLatency(float seconds); // time from a finished frame to it being shown, LED/TFT push
+  float getLatency();                   // seconds from a sound reaching the microphone to it being shown
+
+  /* Spectral Feature Functions */
+  void setFeatures(uint8_t features = AUDIO_FEATURE_ALL, float rolloffPercent = 0.85); // audio_feature flags calculated after every frame. 0 = none
+  uint8_t getFeatures();        // gets the enabled audio_feature flags
+  float getSpectralCentroid();  // Hz, center of mass of the spectrum, brightness
+  float getSpectralRolloff();   // Hz below which rolloffPercent of the spectrum lies
+  float getSpectralFlatness();  // 0 = one tone, 1 = white noise
+  float getSpectralFlux();      // rise of the spectrum since the last frame, in range value units
+  float getZeroCrossingRate();  // sign changes per sample, 0 - 1
+  float getRMS();               // root mean square of the samples, left aligned 32 bit units
+  float getDBFS();              // RMS in dB relative to 32 bit full scale, a full scale sine reads -3dBFS. -200 = silence
+
+  /* Calibration Functions */
+  void setCalibration(float sensitivity = -26, weighting_type weighting = A_WEIGHTING, float leqSeconds = 1); // calibrated levels of the ranges and the whole spectrum. sensitivity = dBFS the microphone reads at 94dB SPL (INMP441 -26), 0 = off
+  bool isCalibrated(); // is calibration enabled
+  float getLevelDBFS();  // weighted level of the last frame, a full scale sine reads -3dBFS. -200 = silence
+  float getLevelDBSPL(); // weighted sound pressure level of the last frame
+  float getLeq();        // dB SPL, energy average of the last finished leqSeconds period. -200 until the first one
+  float toDBFS(float power);  // mean square relative to full scale to dBFS
+  float toDBSPL(float power); // mean square relative to full scale to dB SPL with the calibration
+
   float getSample(uint16_t index); // gets the raw sample value at index
   float getSample(uint16_t index, float min, float max); // calculates the normalized sample value at index
   uint16_t getSampleTriggerIndex(); // finds the index of the first cross point at zero
@@ -132,194 +309,1659 @@ public:
     return _sampleSize;
   }
 
-  /* Library Settings */
-  bool _isAutoLevel = true;
-  float _autoMin = 10; // lowest raw value the autoLevel will fall to before stopping. -1 = will auto level down to 0.
-  float _autoMax = -1; // highest raw value the autoLevel will rise to before clipping. -1 = will not have any clipping.
+  /* Library Settings */
+  bool _isAutoLevel = true;
+  float _autoMin = 10; // lowest raw value the autoLevel will fall to before stopping. -1 = will auto level down to 0.
+  float _autoMax = -1; // highest raw value the autoLevel will rise to before clipping. -1 = will not have any clipping.
+
+  float _min = 0;
+  float _max = 0;
+
+  falloff_type _sampleFalloffType = EXPONENTIAL_FALLOFF;
+  float _sampleFalloffRate = 0.00001;
+  RollingAverage * _samplesRollingAverage = nullptr;
+
+  float mapAndClip(float x, float in_min, float in_max, float out_min, float out_max);
+
+  void analyze(); // calculates FFT and frequency ranges on the current _samples window, the right channel first when stereo
+  void analyzeChannel(); // analyze() of this analyzer's samples only
+  void prepSamples(); // converts, removes DC and windows the samples into _real and tracks the sample min/max
+  void computeBins(); // FFT and the bin pass of every range that reads bins
+  void computeSpectrum(); // FFT and magnitudes of the prepared _real
+  void sumBins(); // adds every bin into the ranges it belongs to
+  void updateRanges(); // hands the sums to the ranges and calculates _min/_max
+  void buildBinTable(); // compiles all registered ranges into one bin -> range weight table
+  uint32_t addBinEntries(FrequencyRange *range, uint8_t rangeIndex, bool fill); // counts or fills the entries of one range
+  void reserveBinEntries();               // sizes the bin table for the most entries any planned format needs
+  void growBinEntries(uint32_t entries);  // bin table arrays for at least entries
+  void selectConstantQKernel();           // kernels of the current format, built when they are not planned
+  void planConstantQ();                   // kernels of every planned sample size at the current rate
+  void buildConstantQKernel(ConstantQKernel &kernel, int sampleSize); // spectral kernels of every constant-Q bin, sparse
+  void computeConstantQ();                // applies the kernels to the complex FFT bins
+  template <typename sample_t>
+  void streamLowResolution(sample_t *samples, int samplesLength); // decimates new samples into the low resolution analyzer
+  template <typename sample_t>
+  void streamGoertzel(sample_t *samples, int samplesLength); // runs every GoertzelRange over new samples
+  template <typename sample_t>
+  bool streamHistory(sample_t *samples, int samplesLength, int sampleSize, int sampleRate); // stream() without the analysis, returns true when a hop is complete
+  float readSample(uint16_t index); // gets the sample at index relative to the start of the current window
+
+  /* FFT Variables */
+  const void *_samples = nullptr;
+  float (*_sampleReader)(const void *samples, uint16_t index) = nullptr; // reads _samples in their own type
+  void (*_samplePreparer)(RealFFT<fft_t> *fft, const void *samples, uint16_t offset, float &absMin, float &absMax, bool window) = nullptr; // RealFFT::prepare() in their own type
+  uint16_t _samplesOffset = 0; // start of the current window within _samples (history ring)
+  int _sampleSize = SAMPLE_SIZE;
+  int _sampleRate = SAMPLE_RATE;
+  fft_t *_real;
+  fft_t *_imag; // real input only has sampleSize / 2 + 1 bins
+  fft_window_t _window = FFT_WINDOW_HAMMING;
+  bool _runningMean = false;
+  RealFFTPlans<fft_t> _plans; // one FFT per sample size, _FFT points at the current one
+  RealFFTPlans<fft_t> *_planSet; // _plans, or the left channel's plans when this is the right channel
+  fft_t _mean = 0;               // DC offset of the last frame, kept here since channels share plans
+
+  FrequencyRange **_frequencyRanges; // allow for extra bands to be monitored
+  uint8_t _frequencyRangesLength = 0;
+  uint8_t _goertzelLength = 0; // GoertzelRanges analysed by this analyzer
+
+  /* Bin Table Variables */
+  uint32_t _generation = 1; // bumped whenever the bins move (sample size, rate, constant-Q), ranges re-index when theirs is older
+  bool _binTableDirty = true;
+  uint32_t *_binStart;                     // entries of bin k are _binStart[k] .. _binStart[k + 1] - 1
+  uint8_t *_binRange = nullptr;            // range index of each entry
+  fft_weight_t *_binWeight = nullptr;      // fractional edge and roll off compensation of each entry
+  uint32_t _binEntriesSize = 0;
+  uint16_t _binFirst = 0;                  // first bin with entries
+  uint16_t _binLast = 0;                   // one past the last bin with entries
+  FrequencyRangeSum *_rangeSums;
+
+  /* Constant-Q Variables */
+  uint8_t _cqBinsPerOctave = 0; // 0 = FFT bins
+  float _cqMinHz = 55;
+  float _cqMaxHz = 14080;
+  bool _cqKernelDirty = false;         // pick the kernels of the current format on the next frame
+  uint16_t _cqBins = 0;
+  ConstantQKernel _cqKernels[16];      // by log2 of the sample size, like the FFT plans
+  ConstantQKernel *_cqKernel = nullptr; // kernels of the current format
+  fft_t *_cqMagnitudes = nullptr;      // sampleCapacity / 2 + 1 values
+  float *_cqScratch = nullptr;         // kernel build buffers for the largest size
+  RealFFTPlans<float> *_cqPlans = nullptr; // FFTs of the kernel build, on _cqScratch
+
+  /* Multi Resolution Variables */
+  AudioFrequencyAnalysisBase *_lowInfo = nullptr;
+  Decimator<fft_t> *_decimator = nullptr;
+  int _lowSampleSize = 0;
+  uint16_t _crossoverHz = 0;
+  float _gain = 1; // applied to every range value, evens out FFT lengths between resolutions
+
+  /* Stereo Variables */
+  AudioFrequencyAnalysisBase *_rightInfo = nullptr;
+
+  /* Governor Variables */
+  float _budgetMicros = 0;       // analysis time allowed per frame, 0 = governor off
+  int _governorMinSampleSize = 256;
+  int _governorMinSampleRate = 8000;
+  int _governorFullSampleSize = 0; // format the governor started from, the most it will ask for
+  int _governorFullSampleRate = 0;
+  int _governedSampleSize = 0;
+  int _governedSampleRate = 0;
+  uint8_t _governorShift = 0;    // extra halvings of the sample size to stay inside the budget
+  uint8_t _governorSettle = 0;   // frames of a new format that are not timed, table rebuilds and cold caches
+  uint8_t _governorFrames = 0;   // frames timed into _governorMicros
+  uint32_t _governorMicros = 0;
+  uint16_t _governorHold = 0;    // frames before a size that blew the budget is tried again
+  float _frameMicros = 0;        // average analyze() time of the last block of frames
+
+  void govern(uint32_t frameMicros); // updates the governed sample size/rate after every frame
+
+  /* Latency Variables */
+  int _inputLatency = 0;    // samples at this analyzer's rate
+  float _outputLatency = 0; // seconds
+
+  /* Spectral Feature Variables */
+  uint8_t _features = AUDIO_FEATURE_NONE;
+  float _rolloffPercent = 0.85;
+  float _centroid = 0;
+  float _rolloff = 0;
+  float _flatness = 0;
+  float _flux = 0;
+  float _zeroCrossingRate = 0;
+  float _rms = 0;
+  fft_t *_lastMagnitudes = nullptr; // spectrum of the last frame for the flux, allocated when the flux is enabled
+  uint32_t _lastMagnitudesGeneration = 0; // _generation the last spectrum was taken at, the flux restarts when the bins moved
+
+  void computeFeatures(); // one pass over the magnitudes of the frame for every enabled spectral feature and the calibrated level
+
+  /* Calibration Variables */
+  float _sensitivity = 0; // dBFS at 94dB SPL, 0 = not calibrated
+  weighting_type _weighting = A_WEIGHTING;
+  float _leqSeconds = 1;
+  float *_weightingTable = nullptr;  // power weight of every FFT bin, allocated by setCalibration()
+  uint32_t _weightingGeneration = 0; // _generation the table was built for, 0 = rebuild
+  float *_binPower = nullptr;        // edge fraction * power weight of every bin table entry, FFT bins only
+  SoundLevel _level;
+
+  void buildWeighting(); // power weights of every FFT bin for the current sample size and rate
+  float powerScale();    // squared FFT bins to the mean square of the samples relative to full scale
+  float frameSeconds();  // time the last frame moved on by
+
+  /* Band Frequency Variables */
+  float _noiseFloor = 0;
+
+  /* Samples Variables */
+  float _samplesMin = 0;
+  float _samplesMax = 1;
+  float _autoLevelSamplesMaxFalloffRate; // used for auto level calculation
+
+  /* Stream Variables */
+  int32_t *_history;             // ring buffer of the last sampleSize samples
+  uint16_t _historyIndex = 0;    // next write position, also the oldest sample in the ring
+  int _hopSize = 0;
+  int _hopCount = 0;             // new samples towards the next hop, the overshoot of the last hop included
+  int _stepCount = 0;            // new samples since the last frame
+  int _frameStep = 0;            // new samples the last frame moved on by
+  int _nominalStep = 0;          // new samples between frames on average
+
+  uint16_t _sampleCapacity;
+  uint8_t _rangeCapacity;
+
+  RealFFT<fft_t> *_FFT = nullptr;
+
+protected:
+  AudioFrequencyAnalysisBase(fft_t *real, fft_t *imag, int32_t *history, uint32_t *binStart, FrequencyRange **frequencyRanges, FrequencyRangeSum *rangeSums, uint16_t sampleCapacity, uint8_t rangeCapacity);
+
+  template <typename sample_t>
+  void setSamples(sample_t *samples, uint16_t offset); // window the analysis reads from
+  template <typename sample_t>
+  static float readSampleAs(const void *samples, uint16_t index);
+  template <typename sample_t>
+  static void prepareAs(RealFFT<fft_t> *fft, const void *samples, uint16_t offset, float &absMin, float &absMax, bool window);
+  template <typename sample_t>
+  static int32_t toHistory(sample_t sample); // a sample as stored in _history
+  static int32_t toHistory(float sample);    // saturated, float samples (the decimated low resolution stream) can overshoot full scale
+  static int32_t toHistory(double sample);
+  bool setFormat(int sampleSize, int sampleRate); // switches FFT plan and tables when size or rate changed
+};
+
+// Analyzer with buffers for up to SampleSize samples and RangeSize frequency ranges.
+//   AudioFrequencyAnalysisT<4096, 8> bassInfo;      // long window for the low end
+//   AudioFrequencyAnalysisT<256, 16> transientInfo; // short window for hits
+template <uint16_t SampleSize = SAMPLE_SIZE, uint8_t RangeSize = BAND_SIZE + BAND_SIZE_PADDING>
+class AudioFrequencyAnalysisT : public AudioFrequencyAnalysisBase
+{
+  static_assert(SampleSize >= 4 && (SampleSize & (SampleSize - 1)) == 0, "SampleSize must be a power of two");
+
+public:
+  AudioFrequencyAnalysisT()
+      : AudioFrequencyAnalysisBase(_realBuffer, _imagBuffer, _historyBuffer, _binStartBuffer, _frequencyRangesBuffer, _rangeSumsBuffer, SampleSize, RangeSize)
+  {
+  }
+
+  template <typename sample_t>
+  AudioFrequencyAnalysisT(sample_t *samples, int sampleSize, int sampleRate)
+      : AudioFrequencyAnalysisT()
+  {
+    setSamples(samples, 0);
+    _sampleSize = min(sampleSize, (int)SampleSize);
+    _sampleRate = sampleRate;
+  }
+
+private:
+  fft_t _realBuffer[SampleSize] = {};
+  fft_t _imagBuffer[SampleSize / 2 + 1] = {};
+  int32_t _historyBuffer[SampleSize] = {};
+  uint32_t _binStartBuffer[SampleSize / 2 + 3];
+  FrequencyRange *_frequencyRangesBuffer[RangeSize];
+  FrequencyRangeSum _rangeSumsBuffer[RangeSize];
+};
+
+typedef AudioFrequencyAnalysisT<> AudioFrequencyAnalysis;
+
+// Right channel analyzer for setStereo(), without FFT buffers of its own: the left analyzer
+// lends it its plans and buffers, so only the history, bin table and ranges are kept here.
+// Only usable after leftInfo.setStereo(&rightInfo), on its own it has nothing to run the FFT on.
+//   AudioFrequencyAnalysis leftInfo;
+//   AudioFrequencyAnalysisRight rightInfo; // 6KB less than a second AudioFrequencyAnalysis at 1024 samples
+template <uint16_t SampleSize = SAMPLE_SIZE, uint8_t RangeSize = BAND_SIZE + BAND_SIZE_PADDING>
+class AudioFrequencyAnalysisRightT : public AudioFrequencyAnalysisBase
+{
+  static_assert(SampleSize >= 4 && (SampleSize & (SampleSize - 1)) == 0, "SampleSize must be a power of two");
+
+public:
+  AudioFrequencyAnalysisRightT()
+      : AudioFrequencyAnalysisBase(nullptr, nullptr, _historyBuffer, _binStartBuffer, _frequencyRangesBuffer, _rangeSumsBuffer, SampleSize, RangeSize)
+  {
+  }
+
+private:
+  int32_t _historyBuffer[SampleSize] = {};
+  uint32_t _binStartBuffer[SampleSize / 2 + 3];
+  FrequencyRange *_frequencyRangesBuffer[RangeSize];
+  FrequencyRangeSum _rangeSumsBuffer[RangeSize];
+};
+
+typedef AudioFrequencyAnalysisRightT<> AudioFrequencyAnalysisRight;
+
+float calculateFalloff(falloff_type falloffType, float falloffRate, float currentRate)
+{
+  switch (falloffType)
+  {
+  case LINEAR_FALLOFF:
+    return falloffRate;
+  case ACCELERATE_FALLOFF:
+    return currentRate + falloffRate;
+  case EXPONENTIAL_FALLOFF:
+    if (currentRate == 0)
+    {
+      currentRate = falloffRate;
+    }
+    return currentRate + currentRate;
+  case ROLLING_AVERAGE_FALLOFF: // calculated in loop() at set min max
+  case NO_FALLOFF:
+  default:
+    return 0;
+  }
+}
+
+AudioFrequencyAnalysisBase::AudioFrequencyAnalysisBase(fft_t *real, fft_t *imag, int32_t *history, uint32_t *binStart, FrequencyRange **frequencyRanges, FrequencyRangeSum *rangeSums, uint16_t sampleCapacity, uint8_t rangeCapacity)
+    : _plans(real, imag)
+{
+  // buffers belong to the derived class and are not constructed yet, only keep the pointers
+  _real = real;
+  _imag = imag;
+  _planSet = &_plans;
+  _history = history;
+  _binStart = binStart;
+  _frequencyRanges = frequencyRanges;
+  _rangeSums = rangeSums;
+  _sampleCapacity = sampleCapacity;
+  _rangeCapacity = rangeCapacity;
+  _sampleSize = sampleCapacity;
+}
+
+AudioFrequencyAnalysisBase::~AudioFrequencyAnalysisBase()
+{
+  delete[] _binRange;
+  delete[] _binWeight;
+  delete[] _binPower;
+  delete[] _cqMagnitudes;
+  delete _cqPlans;
+  delete[] _cqScratch;
+  delete[] _lastMagnitudes;
+  delete[] _weightingTable;
+  delete _decimator;
+  delete _samplesRollingAverage;
+}
+
+void AudioFrequencyAnalysisBase::addFrequencyRange(FrequencyRange *_frequencyRange) {
+  if(_frequencyRangesLength >= _rangeCapacity) {
+    return; // no room left, see RangeSize of AudioFrequencyAnalysisT<>
+  }
+  if(_lowInfo != nullptr && _frequencyRange->_highHz <= _crossoverHz && _lowInfo->_frequencyRangesLength < _lowInfo->_rangeCapacity) {
+    // analysed at low resolution, still listed here for min/max and AudioPipeline
+    _lowInfo->addFrequencyRange(_frequencyRange);
+  }
+  else {
+    _frequencyRange->setAudioInfo(this);
+    if(!_frequencyRange->_usesBins) {
+      _goertzelLength++;
+    }
+  }
+  _frequencyRanges[_frequencyRangesLength] = _frequencyRange;
+  _frequencyRangesLength++;
+  _binTableDirty = true;
+  reserveBinEntries();
+}
+
+template <typename sample_t>
+void AudioFrequencyAnalysisBase::setSamples(sample_t *samples, uint16_t offset)
+{
+  _samples = samples;
+  _sampleReader = &readSampleAs<sample_t>;
+  _samplePreparer = &prepareAs<sample_t>;
+  _samplesOffset = offset;
+}
+
+template <typename sample_t>
+float AudioFrequencyAnalysisBase::readSampleAs(const void *samples, uint16_t index)
+{
+  return ((const sample_t *)samples)[index];
+}
+
+template <typename sample_t>
+void AudioFrequencyAnalysisBase::prepareAs(RealFFT<fft_t> *fft, const void *samples, uint16_t offset, float &absMin, float &absMax, bool window)
+{
+  fft->prepare((const sample_t *)samples, offset, absMin, absMax, window);
+}
+
+template <typename sample_t>
+int32_t AudioFrequencyAnalysisBase::toHistory(sample_t sample)
+{
+  return sample;
+}
+
+int32_t AudioFrequencyAnalysisBase::toHistory(float sample)
+{
+  // out of range float to int conversion is undefined, NaN is stored as silence
+  return sample >= 2147483648.0f ? INT32_MAX : sample >= -2147483648.0f ? (int32_t)sample : sample < 0 ? INT32_MIN : 0;
+}
+
+int32_t AudioFrequencyAnalysisBase::toHistory(double sample)
+{
+  return toHistory((float)sample);
+}
+
+bool AudioFrequencyAnalysisBase::setFormat(int sampleSize, int sampleRate)
+{
+  if (sampleSize > _sampleCapacity)
+  {
+    sampleSize = _sampleCapacity;
+  }
+  bool resized = _FFT == nullptr || _sampleSize != sampleSize;
+  if (!resized && _sampleRate == sampleRate)
+  {
+    return false;
+  }
+  _sampleSize = sampleSize;
+  _sampleRate = sampleRate;
+  if (resized)
+  {
+    _FFT = _planSet->get(_sampleSize); // only allocates for a size begin() did not plan
+  }
+  _generation++;
+  _binTableDirty = true;
+  _cqKernelDirty = _cqBinsPerOctave > 0;
+  return true;
+}
+
+void AudioFrequencyAnalysisBase::begin(int minSampleSize, int maxSampleSize)
+{
+  if (maxSampleSize <= 0 || maxSampleSize > _sampleCapacity)
+  {
+    maxSampleSize = _sampleCapacity;
+  }
+  if (minSampleSize <= 0 || minSampleSize > maxSampleSize)
+  {
+    minSampleSize = maxSampleSize;
+  }
+  _planSet->begin(minSampleSize, maxSampleSize);
+  planConstantQ();
+}
+
+template <typename sample_t>
+void AudioFrequencyAnalysisBase::loop(sample_t *samples, int sampleSize, int sampleRate)
+{
+  setSamples(samples, 0);
+  setFormat(sampleSize, sampleRate);
+  streamLowResolution(samples, _sampleSize);
+  streamGoertzel(samples, _sampleSize);
+  _frameStep = _sampleSize;
+  _nominalStep = _sampleSize;
+  analyze();
+}
+
+template <typename sample_t>
+bool AudioFrequencyAnalysisBase::stream(sample_t *samples, int samplesLength, int sampleSize, int sampleRate)
+{
+  if (!streamHistory(samples, samplesLength, sampleSize, sampleRate))
+  {
+    return false;
+  }
+  // oldest sample in the ring is the start of the window
+  setSamples(_history, _historyIndex);
+  analyze();
+  return true;
+}
+
+template <typename sample_t>
+void AudioFrequencyAnalysisBase::loop(sample_t *left, sample_t *right, int sampleSize, int sampleRate)
+{
+  if (_rightInfo != nullptr)
+  {
+    _rightInfo->setSamples(right, 0);
+    _rightInfo->setFormat(sampleSize, sampleRate);
+    _rightInfo->streamLowResolution(right, _rightInfo->_sampleSize);
+    _rightInfo->streamGoertzel(right, _rightInfo->_sampleSize);
+  }
+  loop(left, sampleSize, sampleRate); // analyze() runs the right channel too
+}
+
+template <typename sample_t>
+bool AudioFrequencyAnalysisBase::stream(sample_t *left, sample_t *right, int samplesLength, int sampleSize, int sampleRate)
+{
+  if (_rightInfo != nullptr)
+  {
+    // both histories move together, the hop of this analyzer decides when both are analysed
+    _rightInfo->streamHistory(right, samplesLength, sampleSize, sampleRate);
+    _rightInfo->setSamples(_rightInfo->_history, _rightInfo->_historyIndex);
+  }
+  return stream(left, samplesLength, sampleSize, sampleRate);
+}
+
+template <typename sample_t>
+bool AudioFrequencyAnalysisBase::streamHistory(sample_t *samples, int samplesLength, int sampleSize, int sampleRate)
+{
+  if (setFormat(sampleSize, sampleRate))
+  {
+    // history no longer lines up with the new window
+    for (int i = 0; i < _sampleCapacity; i++)
+    {
+      _history[i] = 0;
+    }
+    _historyIndex = 0;
+    _hopCount = 0;
+    _stepCount = 0;
+  }
+  streamLowResolution(samples, samplesLength);
+  streamGoertzel(samples, samplesLength);
+
+  if (samplesLength > _sampleSize)
+  {
+    // only the newest sampleSize samples can fit in the window
+    _hopCount += samplesLength - _sampleSize;
+    _stepCount += samplesLength - _sampleSize;
+    samples += samplesLength - _sampleSize;
+    samplesLength = _sampleSize;
+  }
+
+  // write the new samples into the ring, two straight copies when wrapping
+  int first = min(samplesLength, _sampleSize - _historyIndex);
+  for (int i = 0; i < first; i++)
+  {
+    _history[_historyIndex + i] = toHistory(samples[i]);
+  }
+  for (int i = first; i < samplesLength; i++)
+  {
+    _history[i - first] = toHistory(samples[i]);
+  }
+  _historyIndex += samplesLength;
+  if (_historyIndex >= _sampleSize)
+  {
+    _historyIndex -= _sampleSize;
+  }
+  _hopCount += samplesLength;
+  _stepCount += samplesLength;
+
+  int hopSize = _hopSize > 0 && _hopSize < _sampleSize ? _hopSize : _sampleSize;
+  if (_hopCount < hopSize)
+  {
+    return false;
+  }
+  // frames land on read boundaries, the overshoot counts towards the next hop so frames keep the hop rate on average
+  _frameStep = _stepCount;
+  _nominalStep = hopSize;
+  _stepCount = 0;
+  _hopCount = min(_hopCount - hopSize, hopSize - 1); // reads longer than a hop can not catch up with more than one frame
+  return true;
+}
+
+template <typename sample_t>
+void AudioFrequencyAnalysisBase::streamLowResolution(sample_t *samples, int samplesLength)
+{
+  if (_lowInfo == nullptr)
+  {
+    return;
+  }
+  uint8_t factor = _decimator->factor();
+  int lowSampleSize = _lowSampleSize > 0 ? _lowSampleSize : _lowInfo->getSampleCapacity();
+  _lowInfo->_gain = (float)_sampleSize / lowSampleSize; // same height as this FFT for a pure tone
+  fft_t decimated[64];
+  while (samplesLength > 0)
+  {
+    int length = min(samplesLength, 63 * factor); // at most 64 outputs
+    int written = _decimator->process(samples, length, decimated);
+    _lowInfo->stream(decimated, written, lowSampleSize, _sampleRate / factor);
+    samples += length;
+    samplesLength -= length;
+  }
+  // low ranges share this analyzer's min/max until it calculates the next frame
+  _lowInfo->_min = _min;
+  _lowInfo->_max = _max;
+}
+
+template <typename sample_t>
+void AudioFrequencyAnalysisBase::streamGoertzel(sample_t *samples, int samplesLength)
+{
+  for (int r = 0; r < _frequencyRangesLength && _goertzelLength > 0; r++)
+  {
+    FrequencyRange *range = _frequencyRanges[r];
+    if (!range->_usesBins && range->_audioInfo == this)
+    {
+      ((GoertzelRange *)range)->process(samples, samplesLength);
+    }
+  }
+}
+
+void AudioFrequencyAnalysisBase::setHopSize(int hopSize)
+{
+  _hopSize = hopSize;
+}
+
+int AudioFrequencyAnalysisBase::getHopSize()
+{
+  return _hopSize;
+}
+
+int AudioFrequencyAnalysisBase::getFrameStep()
+{
+  return _frameStep;
+}
+
+int AudioFrequencyAnalysisBase::getNominalFrameStep()
+{
+  return _nominalStep;
+}
+
+void AudioFrequencyAnalysisBase::setWindow(fft_window_t window)
+{
+  _window = window;
+  _planSet->setWindow(_window);
+}
+
+fft_window_t AudioFrequencyAnalysisBase::getWindow()
+{
+  return _window;
+}
+
+void AudioFrequencyAnalysisBase::setRunningMean(bool runningMean)
+{
+  _runningMean = runningMean;
+  _planSet->setRunningMean(_runningMean);
+}
+
+float AudioFrequencyAnalysisBase::readSample(uint16_t index)
+{
+  uint16_t i = _samplesOffset + index;
+  if (i >= _sampleSize)
+  {
+    i -= _sampleSize;
+  }
+  return _sampleReader(_samples, i);
+}
+
+void AudioFrequencyAnalysisBase::analyze()
+{
+  AUDIO_PROFILE_SCOPE(AUDIO_STAGE_ANALYSIS);
+  unsigned long start = _budgetMicros > 0 ? micros() : 0;
+  if (_rightInfo != nullptr && _rightInfo->_samples != nullptr)
+  {
+    _rightInfo->_frameStep = _frameStep; // moved on together
+    _rightInfo->_nominalStep = _nominalStep;
+    _rightInfo->analyzeChannel(); // first, so the shared FFT buffers are left holding this channel
+  }
+  analyzeChannel();
+  if (_budgetMicros > 0)
+  {
+    govern(micros() - start);
+  }
+}
+
+void AudioFrequencyAnalysisBase::analyzeChannel()
+{
+  prepSamples();
+
+  // every range calculates its own value, no FFT needed
+  bool binRanges = _goertzelLength == 0;
+  for (int r = 0; r < _frequencyRangesLength && !binRanges; r++)
+  {
+    binRanges = _frequencyRanges[r]->_usesBins && _frequencyRanges[r]->_audioInfo == this;
+  }
+  if (_sensitivity != 0 && _weightingGeneration != _generation)
+  {
+    buildWeighting();
+  }
+  if (binRanges)
+  {
+    computeBins();
+  }
+  else if ((_features & ~AUDIO_FEATURE_ZERO_CROSSINGS) || _sensitivity != 0)
+  {
+    computeSpectrum(); // only the features and the level read it
+  }
+  if (_features != AUDIO_FEATURE_NONE || _sensitivity != 0)
+  {
+    computeFeatures();
+  }
+
+  updateRanges();
+}
+
+void AudioFrequencyAnalysisBase::prepSamples()
+{
+  AUDIO_PROFILE_SCOPE(AUDIO_STAGE_PREP);
+  if(_sampleFalloffType != ROLLING_AVERAGE_FALLOFF) {
+    if (_isAutoLevel)
+    {
+      _autoLevelSamplesMaxFalloffRate = ::calculateFalloff(_sampleFalloffType, _sampleFalloffRate, _autoLevelSamplesMaxFalloffRate);
+      _samplesMax -= _autoLevelSamplesMaxFalloffRate;
+    }
+  }
+  else if(_samplesRollingAverage == nullptr) {
+    // create it;
+    _samplesRollingAverage = new RollingAverage();
+  }
+
+  if (_cqKernelDirty)
+  {
+    selectConstantQKernel();
+  }
+
+  // convert, remove DC and window in one go, unwrapping the window from _samplesOffset.
+  // constant-Q kernels carry their own windows
+  float absMin, absMax;
+  _FFT->setMean(_mean);
+  _samplePreparer(_FFT, _samples, _samplesOffset, absMin, absMax, _cqBins == 0);
+  _mean = _FFT->getMean();
+  if(_sampleFalloffType != ROLLING_AVERAGE_FALLOFF) {
+    if (absMax > _samplesMax)
+    {
+      _samplesMax = absMax;
+      _autoLevelSamplesMaxFalloffRate = 0;
+    }
+    if (absMin < _samplesMin)
+    {
+      _samplesMin = absMin;
+    }
+    return;
+  }
+
+  // the rolling average follows every sample
+  for (int i = 0, j = _samplesOffset; i < _sampleSize; i++, j++)
+  {
+    if (j == _sampleSize)
+    {
+      j = 0;
+    }
+    float v = abs(_sampleReader(_samples, j));
+    float _temp = _samplesMax;
+    if(_samplesMax > v) {
+      _temp = ((_samplesMax - v) * 0.5) + v; // bring max down over time
+      //_temp *= 0.90; // bring max down by 10% over time
+    }
+    else if(v > _samplesMax) {
+      _temp = v;
+    }
+    _samplesRollingAverage->addValue(_temp);
+    _samplesMax = _samplesRollingAverage->getAverage();
+  }
+  if (absMin < _samplesMin)
+  {
+    _samplesMin = absMin;
+  }
+}
+
+void AudioFrequencyAnalysisBase::updateRanges()
+{
+  _min = 0xFFFFFFFF;
+  _max = 0;
+  bool calibrated = _sensitivity != 0 && _cqBins == 0;
+  float toPower = calibrated ? 2 * powerScale() : 0; // bins of both halves of the spectrum
+  float seconds = frameSeconds();
+  for (int r = 0; r < _frequencyRangesLength; r++)
+  {
+    FrequencyRange *range = _frequencyRanges[r];
+    if(range->_audioInfo == this && range->_usesBins) { // low resolution ranges are updated by _lowInfo, Goertzel ranges every block
+      range->loop(_rangeSums[r].sum * _rangeSums[r].scale, _rangeSums[r].maxIndex);
+      if(calibrated) {
+        range->_level.add(_rangeSums[r].power * toPower, seconds, _leqSeconds);
+      }
+    }
+    if(!range->_inIsolation) {
+      if(range->_min < _min) {
+        _min = range->_min;
+      }
+      if(range->_max > _max) {
+        _max = range->_max;
+      }
+    }
+  }
+}
+
+void AudioFrequencyAnalysisBase::computeBins()
+{
+  computeSpectrum();
+  sumBins();
+}
+
+void AudioFrequencyAnalysisBase::computeSpectrum()
+{
+  AUDIO_PROFILE_SCOPE(AUDIO_STAGE_FFT);
+  _FFT->compute();            /* Compute real FFT */
+  if (_cqBins > 0)
+  {
+    computeConstantQ();
+  }
+  _FFT->complexToMagnitude(); /* Compute magnitudes */
+}
+
+void AudioFrequencyAnalysisBase::sumBins()
+{
+  AUDIO_PROFILE_SCOPE(AUDIO_STAGE_BINS);
+  // per range noise gate and scale, the _scaling eq is applied once per range instead of per bin
+  for (int r = 0; r < _frequencyRangesLength; r++)
+  {
+    FrequencyRange *range = _frequencyRanges[r];
+    if (range->binsChanged())
+    {
+      _binTableDirty = true;
+    }
+    // bin units to value, scale down factor to prevent overflow and apply eq scaling
+    float toValue = _FFT->outputScale() * (_cqBins > 0 ? 1 : _FFT->windowScale()) / (float)(0xFFFF * 0xFF) * range->_scaling * _gain;
+    FrequencyRangeSum &rangeSum = _rangeSums[r];
+    rangeSum.gate = FFTMath<fft_t>::gate(_noiseFloor / toValue);
+    rangeSum.scale = toValue * FFTMath<fft_t>::weightScale();
+    rangeSum.sum = 0;
+    rangeSum.maxBin = 0;
+    rangeSum.maxIndex = -1;
+    rangeSum.power = 0;
+  }
+  if (_binTableDirty)
+  {
+    buildBinTable();
+  }
+
+  // one pass over the spectrum, every bin adds its weighted magnitude to the ranges it belongs to
+  bool calibrated = _sensitivity != 0 && _cqBins == 0;
+  for (int i = _binFirst; i < _binLast; i++)
+  {
+    // some smoothing with imaginary numbers.
+    fft_t rv = _cqBins > 0 ? _cqMagnitudes[i] : FFTMath<fft_t>::exactMagnitude(_real[i], _imag[i]);
+    float power = calibrated ? (float)_real[i] * (float)_real[i] : 0; // the plain magnitude, weighting and edges come from the table
+    for (uint32_t e = _binStart[i]; e < _binStart[i + 1]; e++)
+    {
+      FrequencyRangeSum &rangeSum = _rangeSums[_binRange[e]];
+      if (calibrated)
+      {
+        rangeSum.power += power * _binPower[e]; // calibrated levels ignore the noise floor
+      }
+      if (rv < rangeSum.gate)
+      {
+        continue; // below noise floor
+      }
+      fft_acc_t v = FFTMath<fft_t>::weigh(rv, _binWeight[e]);
+      if (v > rangeSum.maxBin)
+      {
+        rangeSum.maxBin = v;
+        rangeSum.maxIndex = i;
+      }
+      // combine band amplitudes for current band segment
+      rangeSum.sum += v;
+    }
+  }
+}
+
+void AudioFrequencyAnalysisBase::buildBinTable()
+{
+  uint16_t bins = getBinCount();
+  for (int i = 0; i < bins + 2; i++)
+  {
+    _binStart[i] = 0;
+  }
+  // count the entries of each bin into _binStart[bin + 2]
+  uint32_t total = 0;
+  for (int r = 0; r < _frequencyRangesLength; r++)
+  {
+    total += addBinEntries(_frequencyRanges[r], r, false);
+  }
+  if (total > _binEntriesSize || (_sensitivity != 0 && _binPower == nullptr))
+  {
+    growBinEntries(total); // only for a format reserveBinEntries() could not see coming, the first sample rate that differs from the one set up with
+  }
+  // prefix sum, _binStart[bin + 1] becomes the fill cursor of each bin
+  for (int i = 2; i < bins + 2; i++)
+  {
+    _binStart[i] += _binStart[i - 1];
+  }
+  // filling moves every cursor to the end of its bin which is _binStart[bin + 1]
+  for (int r = 0; r < _frequencyRangesLength; r++)
+  {
+    addBinEntries(_frequencyRanges[r], r, true);
+  }
+
+  _binFirst = bins;
+  _binLast = 0;
+  for (int i = 0; i < bins; i++)
+  {
+    if (_binStart[i + 1] > _binStart[i])
+    {
+      _binFirst = min(_binFirst, (uint16_t)i);
+      _binLast = i + 1;
+    }
+  }
+  _binTableDirty = false;
+}
+
+void AudioFrequencyAnalysisBase::reserveBinEntries()
+{
+  // a range never has more entries than at the largest size and the lowest rate the governor can pick,
+  // or its width in constant-Q bins, so switching formats while running never grows the table
+  int sampleRate = _budgetMicros > 0 && _cqBinsPerOctave == 0 ? min(_sampleRate, _governorMinSampleRate) : _sampleRate;
+  float maxBins = _sampleCapacity / 2 + 1;
+  uint32_t total = 0;
+  for (int r = 0; r < _frequencyRangesLength; r++)
+  {
+    FrequencyRange *range = _frequencyRanges[r];
+    if (range->_audioInfo != this || !range->_usesBins)
+    {
+      continue;
+    }
+    float entries = (float)(range->_highHz - range->_lowHz) * _sampleCapacity / max(sampleRate, 1);
+    if (_cqBinsPerOctave > 0 && range->_highHz > _cqMinHz)
+    {
+      entries = max(entries, _cqBinsPerOctave * log2f(range->_highHz / max((float)range->_lowHz, _cqMinHz)));
+    }
+    total += (uint32_t)min(max(entries, 0.0f) + 3, maxBins); // edge bins and the two bins of a narrow range
+  }
+  if (total > _binEntriesSize || (_sensitivity != 0 && _binPower == nullptr))
+  {
+    growBinEntries(max(total, _binEntriesSize));
+  }
+}
+
+void AudioFrequencyAnalysisBase::growBinEntries(uint32_t entries)
+{
+  delete[] _binRange;
+  delete[] _binWeight;
+  delete[] _binPower;
+  _binRange = new uint8_t[entries];
+  _binWeight = new fft_weight_t[entries];
+  _binPower = _sensitivity != 0 ? new float[entries] : nullptr;
+  _binEntriesSize = entries;
+  _binTableDirty = true;
+}
+
+uint32_t AudioFrequencyAnalysisBase::addBinEntries(FrequencyRange *range, uint8_t rangeIndex, bool fill)
+{
+  if (range->_audioInfo != this || !range->_usesBins)
+  {
+    return 0; // bins come from the low resolution analyzer, GoertzelRanges have none
+  }
+  if (fill)
+  {
+    range->_tableLowHz = range->_lowHz;
+    range->_tableHighHz = range->_highHz;
+    range->_tableRollOffCompensation = range->_highFrequencyRollOffCompensation;
+  }
+  else
+  {
+    range->reindex(); // counting runs first, once per table build
+  }
+  float lowIndex = range->_lowBinIndex;
+  float highIndex = range->_highBinIndex;
+  float width = highIndex - lowIndex;
+  float center = (lowIndex + highIndex) / 2;
+
+  uint32_t count = 0;
+  for (int i = range->_startSampleIndex; i < range->_endSampleIndex; i++)
+  {
+    float weight;
+    if (width < 1)
+    {
+      weight = 1 - fabs(center - i);
+    }
+    else
+    {
+      // fraction of the bin inside the range
+      weight = min(highIndex, (float)(i + 0.5)) - max(lowIndex, (float)(i - 0.5));
+    }
+    if (weight <= 0)
+    {
+      continue;
+    }
+    if (fill && _binPower != nullptr && _sensitivity != 0 && _cqBins == 0)
+    {
+      _binPower[_binStart[i + 1]] = weight * _weightingTable[i]; // before the roll off compensation, levels stay calibrated
+    }
+    if (range->_highFrequencyRollOffCompensation > 0)
+    {
+      uint16_t frequency = getBinFrequency(i);
+      weight *= pow(frequency, range->_highFrequencyRollOffCompensation);
+    }
+    if (fill)
+    {
+      uint32_t e = _binStart[i + 1]++;
+      _binRange[e] = rangeIndex;
+      _binWeight[e] = FFTMath<fft_t>::toWeight(weight);
+    }
+    else
+    {
+      _binStart[i + 2]++;
+    }
+    count++;
+  }
+  return count;
+}
+
+void AudioFrequencyAnalysisBase::setConstantQ(uint8_t binsPerOctave, float minHz, float maxHz)
+{
+  _cqBinsPerOctave = binsPerOctave;
+  _cqMinHz = minHz;
+  _cqMaxHz = maxHz;
+  _cqKernelDirty = true;
+  _binTableDirty = true;
+  for (int i = 0; i < 16; i++)
+  {
+    _cqKernels[i].sampleRate = 0; // built for other settings
+  }
+  if (binsPerOctave > 0 && _cqMagnitudes == nullptr)
+  {
+    // sized once for the largest sample size, kernel builds reuse them
+    uint16_t bins = _sampleCapacity / 2 + 1;
+    _cqMagnitudes = new fft_t[bins]();
+    _cqScratch = new float[_sampleCapacity + 3 * bins];
+    _cqPlans = new RealFFTPlans<float>(_cqScratch, _cqScratch + _sampleCapacity);
+  }
+  planConstantQ();
+  reserveBinEntries();
+}
+
+void AudioFrequencyAnalysisBase::setMultiResolution(AudioFrequencyAnalysisBase *lowInfo, uint8_t decimation, int sampleSize, uint16_t crossoverHz)
+{
+  _lowInfo = lowInfo;
+  _lowSampleSize = sampleSize;
+  if (_decimator == nullptr)
+  {
+    _decimator = new Decimator<fft_t>();
+  }
+  _decimator->begin(decimation);
+  // the decimator keeps the bottom 0.4 of the low sample rate free of aliasing
+  _crossoverHz = crossoverHz > 0 ? crossoverHz : 0.4 * _sampleRate / _decimator->factor();
+  setInputLatency(_inputLatency);
+  setOutputLatency(_outputLatency);
+  if (_sensitivity != 0)
+  {
+    setCalibration(_sensitivity, _weighting, _leqSeconds);
+  }
+}
+
+AudioFrequencyAnalysisBase *AudioFrequencyAnalysisBase::getLowResolution()
+{
+  return _lowInfo;
+}
+
+uint16_t AudioFrequencyAnalysisBase::getCrossover()
+{
+  return _crossoverHz;
+}
+
+void AudioFrequencyAnalysisBase::setStereo(AudioFrequencyAnalysisBase *rightInfo)
+{
+  _rightInfo = rightInfo;
+  // RealFFT already packs each channel's real samples into a half size complex FFT, so the channels
+  // take turns on one set of plans (sine tables, windows, twiddles) and FFT buffers instead
+  rightInfo->_planSet = &_plans;
+  rightInfo->_real = _real;
+  rightInfo->_imag = _imag;
+  rightInfo->_sampleCapacity = min(rightInfo->_sampleCapacity, _sampleCapacity);
+  rightInfo->_window = _window;
+  rightInfo->_runningMean = _runningMean;
+  rightInfo->_FFT = nullptr; // picks a shared plan on the next frame
+  setInputLatency(_inputLatency);
+  setOutputLatency(_outputLatency);
+  setFeatures(_features, _rolloffPercent);
+  if (_sensitivity != 0)
+  {
+    setCalibration(_sensitivity, _weighting, _leqSeconds);
+  }
+}
+
+AudioFrequencyAnalysisBase *AudioFrequencyAnalysisBase::getRightChannel()
+{
+  return _rightInfo;
+}
+
+void AudioFrequencyAnalysisBase::setFrameBudget(float framesPerSecond, int minSampleSize, int minSampleRate)
+{
+  if (_budgetMicros == 0)
+  {
+    // format of the next frame is where the governor starts from, a new budget keeps it
+    _governorFullSampleSize = 0;
+    _governedSampleSize = 0;
+    _governedSampleRate = 0;
+    _governorShift = 0;
+  }
+  _budgetMicros = framesPerSecond > 0 ? 1000000 / framesPerSecond : 0;
+  _governorMinSampleSize = min(minSampleSize, (int)_sampleCapacity);
+  _governorMinSampleRate = minSampleRate;
+  _governorSettle = 4;
+  _governorFrames = 0;
+  _governorMicros = 0;
+  _governorHold = 0;
+  if (_budgetMicros > 0)
+  {
+    begin(_governorMinSampleSize); // every size the governor can pick and its constant-Q kernels, stepping never allocates
+    reserveBinEntries();
+  }
+}
+
+int AudioFrequencyAnalysisBase::getGovernedSampleSize()
+{
+  return _budgetMicros > 0 && _governedSampleSize > 0 ? _governedSampleSize : _sampleSize;
+}
+
+int AudioFrequencyAnalysisBase::getGovernedSampleRate()
+{
+  return _budgetMicros > 0 && _governedSampleRate > 0 ? _governedSampleRate : _sampleRate;
+}
+
+float AudioFrequencyAnalysisBase::getFrameTime()
+{
+  return _frameMicros;
+}
+
+void AudioFrequencyAnalysisBase::setInputLatency(int samples)
+{
+  _inputLatency = samples;
+  if (_lowInfo != nullptr)
+  {
+    // decimated samples plus the decimator delay, half of its 16 taps per phase
+    _lowInfo->setInputLatency(samples / _decimator->factor() + 8);
+  }
+  if (_rightInfo != nullptr)
+  {
+    _rightInfo->setInputLatency(samples);
+  }
+}
+
+void AudioFrequencyAnalysisBase::setOutputLatency(float seconds)
+{
+  _outputLatency = seconds;
+  if (_lowInfo != nullptr)
+  {
+    _lowInfo->setOutputLatency(seconds);
+  }
+  if (_rightInfo != nullptr)
+  {
+    _rightInfo->setOutputLatency(seconds);
+  }
+}
+
+float AudioFrequencyAnalysisBase::getLatency()
+{
+  // a sound is analysed best once it reaches the middle of the window, and waits half a frame step
+  // on average for the frame that holds it. the analysis time is only known while the governor is on
+  int step = _frameStep > 0 ? _frameStep : _sampleSize;
+  float samples = _inputLatency + 0.5f * (_sampleSize + step);
+  return samples / _sampleRate + _frameMicros / 1000000 + _outputLatency;
+}
+
+void AudioFrequencyAnalysisBase::setFeatures(uint8_t features, float rolloffPercent)
+{
+  _features = features;
+  _rolloffPercent = rolloffPercent;
+  if ((features & AUDIO_FEATURE_FLUX) && _lastMagnitudes == nullptr)
+  {
+    _lastMagnitudes = new fft_t[_sampleCapacity / 2 + 1];
+    _lastMagnitudesGeneration = 0;
+  }
+  if (_rightInfo != nullptr)
+  {
+    _rightInfo->setFeatures(features, rolloffPercent);
+  }
+}
+
+uint8_t AudioFrequencyAnalysisBase::getFeatures()
+{
+  return _features;
+}
+
+float AudioFrequencyAnalysisBase::getSpectralCentroid()
+{
+  return _centroid;
+}
+
+float AudioFrequencyAnalysisBase::getSpectralRolloff()
+{
+  return _rolloff;
+}
+
+float AudioFrequencyAnalysisBase::getSpectralFlatness()
+{
+  return _flatness;
+}
+
+float AudioFrequencyAnalysisBase::getSpectralFlux()
+{
+  return _flux;
+}
+
+float AudioFrequencyAnalysisBase::getZeroCrossingRate()
+{
+  return _zeroCrossingRate;
+}
+
+float AudioFrequencyAnalysisBase::getRMS()
+{
+  return _rms;
+}
+
+float AudioFrequencyAnalysisBase::getDBFS()
+{
+  float rms = _rms / 2147483648.0f;
+  return toDBFS(rms * rms);
+}
+
+void AudioFrequencyAnalysisBase::setCalibration(float sensitivity, weighting_type weighting, float leqSeconds)
+{
+  _sensitivity = sensitivity;
+  _weighting = weighting;
+  _leqSeconds = leqSeconds;
+  if (sensitivity != 0 && _weightingTable == nullptr)
+  {
+    _weightingTable = new float[_sampleCapacity / 2 + 1];
+  }
+  _weightingGeneration = 0; // rebuilt on the next frame
+  _binTableDirty = true;
+  reserveBinEntries();
+  if (_lowInfo != nullptr)
+  {
+    _lowInfo->setCalibration(sensitivity, weighting, leqSeconds);
+  }
+  if (_rightInfo != nullptr)
+  {
+    _rightInfo->setCalibration(sensitivity, weighting, leqSeconds);
+  }
+}
+
+bool AudioFrequencyAnalysisBase::isCalibrated()
+{
+  return _sensitivity != 0;
+}
 
-  float _min = 0;
-  float _max = 0;
+float AudioFrequencyAnalysisBase::getLevelDBFS()
+{
+  return toDBFS(_level.power);
+}
 
-  falloff_type _sampleFalloffType = EXPONENTIAL_FALLOFF;
-  float _sampleFalloffRate = 0.00001;
-  RollingAverage * _samplesRollingAverage = nullptr;
+float AudioFrequencyAnalysisBase::getLevelDBSPL()
+{
+  return toDBSPL(_level.power);
+}
 
-  float mapAndClip(float x, float in_min, float in_max, float out_min, float out_max);
+float AudioFrequencyAnalysisBase::getLeq()
+{
+  return toDBSPL(_level.leq);
+}
 
-  /* FFT Variables */
-  int32_t *_samples = nullptr;
-  int _sampleSize = SAMPLE_SIZE;
-  int _sampleRate = SAMPLE_RATE;
-  float _real[SAMPLE_SIZE];
-  float _imag[SAMPLE_SIZE];
-  float _weighingFactors[SAMPLE_SIZE];
+float AudioFrequencyAnalysisBase::toDBFS(float power)
+{
+  return power > 0 ? max(10 * log10f(power), -200.0f) : -200;
+}
 
-  FrequencyRange *_frequencyRanges[BAND_SIZE + BAND_SIZE_PADDING]; // allow for extra bands to be monitored
-  uint8_t _frequencyRangesLength = 0;
+float AudioFrequencyAnalysisBase::toDBSPL(float power)
+{
+  // microphone datasheets give the sensitivity for a sine with 0dBFS at full scale peak, 3dB above its RMS
+  return power > 0 ? toDBFS(power) + 3.0103f - _sensitivity + 94 : -200;
+}
 
-  /* Band Frequency Variables */
-  float _noiseFloor = 0;
+void AudioFrequencyAnalysisBase::buildWeighting()
+{
+  // IEC 61672 weightings as power gains, built once per sample size and rate so no frame calls pow()
+  const double f1 = 20.598997 * 20.598997;
+  const double f2 = 107.65265 * 107.65265;
+  const double f3 = 737.86223 * 737.86223;
+  const double f4 = 12194.217 * 12194.217;
+  uint16_t bins = _sampleSize / 2 + 1;
+  for (int i = 0; i < bins; i++)
+  {
+    double f = (double)i * _sampleRate / _sampleSize;
+    double ff = f * f;
+    double gain = 1;
+    if (_weighting == A_WEIGHTING)
+    {
+      gain = f4 * ff * ff / ((ff + f1) * sqrt((ff + f2) * (ff + f3)) * (ff + f4)) * 1.2588966; // +2dB, 0dB at 1kHz
+    }
+    else if (_weighting == C_WEIGHTING)
+    {
+      gain = f4 * ff / ((ff + f1) * (ff + f4)) * 1.0072384; // +0.062dB, 0dB at 1kHz
+    }
+    _weightingTable[i] = gain * gain;
+  }
+  _weightingGeneration = _generation;
+  _binTableDirty = true; // range entries carry the weights too
+}
 
-  /* Samples Variables */
-  float _samplesMin = 0;
-  float _samplesMax = 1;
-  float _autoLevelSamplesMaxFalloffRate; // used for auto level calculation
+float AudioFrequencyAnalysisBase::powerScale()
+{
+  // Parseval: mean square = sum of |bin|^2 over the whole spectrum / N^2, then the power the window
+  // took is given back (its mean square, not the coherent gain, since a range sums several bins)
+  float windowPower = _cqBins > 0 ? 1 : _FFT->windowPower();
+  float scale = _FFT->outputScale() / (_sampleSize * 2147483648.0f);
+  return scale * scale / windowPower;
+}
 
-  ArduinoFFT<float> *_FFT = nullptr;
-};
+float AudioFrequencyAnalysisBase::frameSeconds()
+{
+  int step = _frameStep > 0 ? _frameStep : _sampleSize;
+  return _sampleRate > 0 ? (float)step / _sampleRate : 0;
+}
 
-float calculateFalloff(falloff_type falloffType, float falloffRate, float currentRate)
+void AudioFrequencyAnalysisBase::computeFeatures()
 {
-  switch (falloffType)
+  AUDIO_PROFILE_SCOPE(AUDIO_STAGE_FEATURES);
+  uint16_t bins = _sampleSize / 2 + 1;
+  bool centroid = _features & (AUDIO_FEATURE_CENTROID | AUDIO_FEATURE_ROLLOFF);
+  bool flatness = _features & AUDIO_FEATURE_FLATNESS;
+  bool rms = _features & AUDIO_FEATURE_RMS;
+  bool flux = (_features & AUDIO_FEATURE_FLUX) && _lastMagnitudes != nullptr;
+  bool fluxReady = flux && _lastMagnitudesGeneration == _generation; // bins of the last frame line up with these
+  bool level = _sensitivity != 0;
+  if ((_features & ~AUDIO_FEATURE_ZERO_CROSSINGS) || level)
   {
-  case LINEAR_FALLOFF:
-    return falloffRate;
-  case ACCELERATE_FALLOFF:
-    return currentRate + falloffRate;
-  case EXPONENTIAL_FALLOFF:
-    if (currentRate == 0)
+    // one pass over the FFT magnitudes (_real after complexToMagnitude()), every enabled feature adds its part.
+    // sums stay in the FFT number type, fixed point only converts per bin for the power and the log
+    fft_acc_t sum = 0;
+    fft_acc_t weighted = 0;
+    fft_acc_t rise = 0;
+    float power = 0;
+    float logPower = 0;
+    float weightedPower = 0;
+    for (int i = 0; i < bins; i++)
     {
-      currentRate = falloffRate;
+      fft_t m = _real[i];
+      if (centroid)
+      {
+        sum += m;
+        weighted += (fft_acc_t)m * i;
+      }
+      if (flatness || rms || level)
+      {
+        float p = (float)m * (float)m;
+        power += p;
+        logPower += flatness ? logf(p + 1e-10f) : 0;
+        weightedPower += level ? p * _weightingTable[i] : 0;
+      }
+      if (flux)
+      {
+        if (fluxReady && m > _lastMagnitudes[i])
+        {
+          rise += m - _lastMagnitudes[i];
+        }
+        _lastMagnitudes[i] = m;
+      }
     }
-    return currentRate + currentRate;
-  case ROLLING_AVERAGE_FALLOFF: // calculated in loop() at set min max
-  case NO_FALLOFF:
-  default:
-    return 0;
+
+    float binHz = (float)_sampleRate / _sampleSize;
+    if (_features & AUDIO_FEATURE_CENTROID)
+    {
+      _centroid = sum > 0 ? (float)weighted / (float)sum * binHz : 0;
+    }
+    if (_features & AUDIO_FEATURE_ROLLOFF)
+    {
+      // the total is only known after the pass, walk up to the rolloff bin
+      fft_acc_t limit = (fft_acc_t)((float)sum * _rolloffPercent);
+      fft_acc_t cumulative = 0;
+      int i = 0;
+      while (i < bins - 1 && (cumulative += _real[i]) < limit)
+      {
+        i++;
+      }
+      _rolloff = sum > 0 ? i * binHz : 0;
+    }
+    if (flatness)
+    {
+      // geometric over arithmetic mean of the power spectrum, silence counts as white
+      _flatness = min(expf(logPower / bins) / (power / bins + 1e-10f), 1.0f);
+    }
+    if (flux)
+    {
+      // same units as the range values without their eq _scaling
+      float toValue = _FFT->outputScale() * (_cqBins > 0 ? 1 : _FFT->windowScale()) / (float)(0xFFFF * 0xFF) * _gain;
+      _flux = fluxReady ? (float)rise * toValue : 0;
+      _lastMagnitudesGeneration = _generation;
+    }
+    if (rms)
+    {
+      // Parseval, the sum of the squared samples is the power of both halves of the spectrum / N
+      // (DC and Nyquist only once), then the power the window took is given back
+      float first = _real[0];
+      float last = _real[bins - 1];
+      float squares = (2 * power - first * first - last * last) / _sampleSize;
+      float windowPower = _cqBins > 0 ? 1 : _FFT->windowPower();
+      _rms = sqrtf(max(squares, 0.0f) / (_sampleSize * windowPower)) * _FFT->outputScale();
+    }
+    if (level)
+    {
+      // same as the RMS with every bin weighted, the level of the whole spectrum
+      float first = (float)_real[0] * (float)_real[0] * _weightingTable[0];
+      float last = (float)_real[bins - 1] * (float)_real[bins - 1] * _weightingTable[bins - 1];
+      _level.add(max(2 * weightedPower - first - last, 0.0f) * powerScale(), frameSeconds(), _leqSeconds);
+    }
+  }
+
+  if (_features & AUDIO_FEATURE_ZERO_CROSSINGS)
+  {
+    // from the samples, _real only holds the windowed ones and the flat top window changes their sign
+    float mean = (float)_mean * (1 << FFTMath<fft_t>::headroomShift);
+    int crossings = 0;
+    bool negative = readSample(0) < mean;
+    for (int i = 1; i < _sampleSize; i++)
+    {
+      bool n = readSample(i) < mean;
+      crossings += n != negative;
+      negative = n;
+    }
+    _zeroCrossingRate = (float)crossings / (_sampleSize - 1);
   }
 }
 
-AudioFrequencyAnalysis::AudioFrequencyAnalysis(int32_t *samples, int sampleSize, int sampleRate)
+void AudioFrequencyAnalysisBase::govern(uint32_t frameMicros)
 {
-  AudioFrequencyAnalysis();
-  _samples = samples;
-  _sampleSize = sampleSize;
-  _sampleRate = sampleRate;
-  for (int i = 0; i < SAMPLE_SIZE; i++)
+  if (_governorFullSampleSize == 0)
+  {
+    // the format the sketch started with is the most the governor will ask for
+    _governorFullSampleSize = _sampleSize;
+    _governorFullSampleRate = _sampleRate;
+    _governedSampleSize = _sampleSize;
+    _governedSampleRate = _sampleRate;
+  }
+  if (_sampleSize != _governedSampleSize || _sampleRate != _governedSampleRate)
+  {
+    return; // last request not applied yet, the time is for the old format
+  }
+  if (_governorSettle > 0)
+  {
+    _governorSettle--;
+    return;
+  }
+  _governorMicros += frameMicros;
+  if (++_governorFrames < 16)
+  {
+    return;
+  }
+  _frameMicros = (float)_governorMicros / _governorFrames;
+  _governorMicros = 0;
+  _governorFrames = 0;
+  _governorHold = _governorHold > 16 ? _governorHold - 16 : 0;
+
+  // lowest rate that still has every range below 0.46 of it, the rest is kept clear for the mic's anti alias filter.
+  // divisions of the full rate so 44.1k drops to 22.05k/14.7k/11.025k and 48k to 24k/16k/12k.
+  // multi resolution keeps its rate, the crossover was picked for it. constant-Q keeps it too, its kernels are planned per size at one rate
+  uint16_t highHz = 0;
+  for (int r = 0; r < _frequencyRangesLength; r++)
+  {
+    highHz = max(highHz, _frequencyRanges[r]->_highHz);
+  }
+  for (int r = 0; _rightInfo != nullptr && r < _rightInfo->_frequencyRangesLength; r++)
+  {
+    highHz = max(highHz, _rightInfo->_frequencyRanges[r]->_highHz);
+  }
+  static const uint8_t divisors[] = {6, 4, 3, 2, 1};
+  int rate = _governorFullSampleRate;
+  int divisor = 1;
+  for (int i = 0; i < 5 && _lowInfo == nullptr && _cqBinsPerOctave == 0 && _frequencyRangesLength > 0; i++)
+  {
+    int candidate = _governorFullSampleRate / divisors[i];
+    if (candidate >= _governorMinSampleRate && candidate * 0.46f >= highHz)
+    {
+      rate = candidate;
+      divisor = divisors[i];
+      break;
+    }
+  }
+
+  // same bin width as the full format, then halved while the frames do not fit the budget
+  if (_frameMicros > _budgetMicros && (_governedSampleSize >> 1) >= _governorMinSampleSize)
+  {
+    _governorShift++;
+    _governorHold = 512; // no flapping between a size that fits and one that does not
+  }
+  else if (_frameMicros * 2.5f < _budgetMicros && _governorShift > 0 && _governorHold == 0)
+  {
+    _governorShift--; // doubling the size a bit more than doubles the time
+  }
+  int size = 4;
+  while (size * divisor < _governorFullSampleSize)
   {
-    _real[i] = 0;
-    _imag[i] = 0;
+    size <<= 1;
+  }
+  size = max(size >> _governorShift, min(_governorMinSampleSize, size));
+
+  if (size != _governedSampleSize || rate != _governedSampleRate)
+  {
+    _governedSampleSize = size;
+    _governedSampleRate = rate;
+    _governorSettle = 4;
   }
 }
 
-AudioFrequencyAnalysis::AudioFrequencyAnalysis()
+bool AudioFrequencyAnalysisBase::isConstantQ()
 {
-  _samples = nullptr;
+  return _cqBins > 0;
 }
 
-void AudioFrequencyAnalysis::addFrequencyRange(FrequencyRange *_frequencyRange) {
-  _frequencyRange->setAudioInfo(this);
-  _frequencyRanges[_frequencyRangesLength] = _frequencyRange;
-  _frequencyRangesLength++;
+fft_t *AudioFrequencyAnalysisBase::getConstantQ()
+{
+  return _cqMagnitudes;
 }
 
-void AudioFrequencyAnalysis::loop(int32_t *samples, int sampleSize, int sampleRate)
+uint16_t AudioFrequencyAnalysisBase::getBinCount()
 {
-  _samples = samples;
-  if (_FFT == nullptr || _sampleSize != sampleSize || _sampleRate != sampleRate)
+  return _cqBins > 0 ? _cqBins : _sampleSize / 2 + 1;
+}
+
+float AudioFrequencyAnalysisBase::getBinFrequency(float index)
+{
+  if (_cqBins > 0)
   {
-    _sampleSize = sampleSize;
-    _sampleRate = sampleRate;
-    _FFT = new ArduinoFFT<float>(_real, _imag, _sampleSize, _sampleRate, _weighingFactors);
+    return _cqMinHz * pow(2, index / _cqBinsPerOctave);
   }
+  return index * _sampleRate / _sampleSize;
+}
 
-  if(_sampleFalloffType != ROLLING_AVERAGE_FALLOFF) {
-    if (_isAutoLevel)
+float AudioFrequencyAnalysisBase::getBinIndex(float hz)
+{
+  if (_cqBins > 0)
+  {
+    return hz > 0 ? _cqBinsPerOctave * log2(hz / _cqMinHz) : -INFINITY;
+  }
+  return hz * _sampleSize / _sampleRate;
+}
+
+void AudioFrequencyAnalysisBase::selectConstantQKernel()
+{
+  _cqKernelDirty = false;
+  _generation++; // bins move between FFT and constant-Q or to the kernels of another format
+  _binTableDirty = true;
+  _cqKernel = nullptr;
+  _cqBins = 0;
+  if (_cqBinsPerOctave == 0)
+  {
+    return;
+  }
+  uint8_t slot = 0;
+  while ((1 << (slot + 1)) <= _sampleSize)
+  {
+    slot++;
+  }
+  ConstantQKernel &kernel = _cqKernels[slot];
+  if (kernel.sampleRate != _sampleRate)
+  {
+    planConstantQ(); // first frame at this rate, every planned size at once so later size changes find theirs
+  }
+  if (kernel.sampleRate != _sampleRate)
+  {
+    buildConstantQKernel(kernel, _sampleSize); // size begin() did not plan
+  }
+  _cqKernel = &kernel;
+  _cqBins = kernel.bins;
+}
+
+void AudioFrequencyAnalysisBase::planConstantQ()
+{
+  if (_cqBinsPerOctave == 0)
+  {
+    return;
+  }
+  for (uint32_t n = 4, slot = 2; n <= _sampleCapacity; n <<= 1, slot++)
+  {
+    if (_planSet->isPlanned(n) && _cqKernels[slot].sampleRate != _sampleRate)
     {
-      _autoLevelSamplesMaxFalloffRate = ::calculateFalloff(_sampleFalloffType, _sampleFalloffRate, _autoLevelSamplesMaxFalloffRate);
-      _samplesMax -= _autoLevelSamplesMaxFalloffRate;
+      buildConstantQKernel(_cqKernels[slot], n);
     }
   }
-  else if(_samplesRollingAverage == nullptr) {
-    // create it;
-    _samplesRollingAverage = new RollingAverage();
+}
+
+void AudioFrequencyAnalysisBase::buildConstantQKernel(ConstantQKernel &kernel, int sampleSize)
+{
+  kernel.sampleRate = _sampleRate;
+  kernel.bins = 0;
+  float maxHz = min(_cqMaxHz, _sampleRate / 2.0f);
+  if (_cqMinHz <= 0 || maxHz <= _cqMinHz)
+  {
+    return;
+  }
+  uint16_t half = sampleSize / 2;
+  uint16_t bins = min((int)(_cqBinsPerOctave * log2(maxHz / _cqMinHz)) + 1, half + 1); // bin table holds at most sampleSize / 2 + 1 bins
+  float q = 1 / (pow(2, 1.0 / _cqBinsPerOctave) - 1);
+
+  // every kernel is a Hamming windowed complex sinusoid of q periods, capped at sampleSize samples.
+  // its spectrum only has a main lobe of +-2 * sampleSize / length bins above 1% (side lobes are -43dB)
+  uint32_t total = 0;
+  for (uint16_t k = 0; k < bins; k++)
+  {
+    float hz = _cqMinHz * pow(2, (float)k / _cqBinsPerOctave);
+    int length = min((int)ceil(q * _sampleRate / hz), sampleSize);
+    total += 4 * sampleSize / length + 3;
+  }
+  if (kernel.start == nullptr)
+  {
+    kernel.start = new uint32_t[half + 2];
+  }
+  if (total > kernel.capacity)
+  {
+    // first build of this size, or a higher rate than it was built for
+    delete[] kernel.index;
+    delete[] kernel.real;
+    delete[] kernel.imag;
+    kernel.index = new uint16_t[total];
+    kernel.real = new fft_t[total];
+    kernel.imag = new fft_t[total];
+    kernel.capacity = total;
   }
 
+  // spectrum of the complex kernel from two real FFTs, one for the cos part and one for the sin part
+  float *real = _cqScratch;
+  float *imag = real + _sampleCapacity;
+  float *cosReal = imag + _sampleCapacity / 2 + 1;
+  float *cosImag = cosReal + _sampleCapacity / 2 + 1;
+  RealFFT<float> *fft = _cqPlans->get(sampleSize);
 
-  // prep samples for analysis
-  for (int i = 0; i < _sampleSize; i++)
+  uint32_t e = 0;
+  for (uint16_t k = 0; k < bins; k++)
   {
-    _real[i] = samples[i];
-    _imag[i] = 0;
-    float v = abs(samples[i]);
-    if(_sampleFalloffType == ROLLING_AVERAGE_FALLOFF) {
-      float _temp = _samplesMax;
-      if(_samplesMax > v) {
-        _temp = ((_samplesMax - v) * 0.5) + v; // bring max down over time
-        //_temp *= 0.90; // bring max down by 10% over time
+    kernel.start[k] = e;
+    float hz = _cqMinHz * pow(2, (float)k / _cqBinsPerOctave);
+    int length = max(min((int)ceil(q * _sampleRate / hz), sampleSize), 2);
+    int start = (sampleSize - length) / 2; // centered in the frame
+    float gain = (float)sampleSize / length; // same height as an FFT bin for every length
+    for (int part = 0; part < 2; part++)
+    {
+      for (int n = 0; n < sampleSize; n++)
+      {
+        real[n] = 0;
       }
-      else if(v > _samplesMax) {
-        _temp = v;
+      for (int n = 0; n < length; n++)
+      {
+        float w = (0.54 - 0.46 * cos(TWO_PI * n / (length - 1))) * gain;
+        float phase = TWO_PI * hz * n / _sampleRate;
+        real[start + n] = part == 0 ? w * cos(phase) : w * sin(phase);
       }
-      _samplesRollingAverage->addValue(_temp);
-      _samplesMax = _samplesRollingAverage->getAverage();
-    }
-    else {
-      if (v > _samplesMax)
+      fft->compute();
+      if (part == 0)
       {
-        _samplesMax = v;
-        _autoLevelSamplesMaxFalloffRate = 0;
+        memcpy(cosReal, real, sizeof(float) * (half + 1));
+        memcpy(cosImag, imag, sizeof(float) * (half + 1));
       }
     }
-    if (v < _samplesMin)
+
+    // kernel = cos spectrum + i * sin spectrum, keep conj(kernel) / sampleSize around the main lobe
+    float center = hz * sampleSize / _sampleRate;
+    float lobe = 2.0 * sampleSize / length + 1;
+    int first = max((int)floor(center - lobe), 0);
+    int last = min((int)ceil(center + lobe), (int)half);
+    float peak = 0;
+    for (int j = first; j <= last; j++)
     {
-      _samplesMin = v;
+      float kr = cosReal[j] - imag[j];
+      float ki = cosImag[j] + real[j];
+      peak = max(peak, kr * kr + ki * ki);
     }
-  }
-
-  _FFT->dcRemoval();
-  _FFT->windowing(FFTWindow::Hamming, FFTDirection::Forward, false); /* Weigh data (compensated) */
-  _FFT->compute(FFTDirection::Forward);                              /* Compute FFT */
-  _FFT->complexToMagnitude();                                        /* Compute magnitudes */
-
-
-  uint8_t seen = 0;
-  _min = 0xFFFFFFFF;
-  _max = 0;
-  for(int i = 0; seen <_frequencyRangesLength && i < BAND_SIZE + BAND_SIZE_PADDING; i++) {
-    if(_frequencyRanges[i] != nullptr) {
-      _frequencyRanges[i]->loop();
-      seen++;
-      if(!_frequencyRanges[i]->_inIsolation) {
-        if(_frequencyRanges[i]->_min < _min) {
-          _min = _frequencyRanges[i]->_min;
-        }
-        if(_frequencyRanges[i]->_max > _max) {
-          _max = _frequencyRanges[i]->_max;
-        }
+    for (int j = first; j <= last; j++)
+    {
+      float kr = cosReal[j] - imag[j];
+      float ki = cosImag[j] + real[j];
+      if (kr * kr + ki * ki < peak * 0.0001) // below 1% of the peak
+      {
+        continue;
       }
+      kernel.index[e] = j;
+      kernel.real[e] = FFTMath<fft_t>::fromDouble(kr / sampleSize);
+      kernel.imag[e] = FFTMath<fft_t>::fromDouble(-ki / sampleSize);
+      e++;
     }
   }
+  kernel.start[bins] = e;
+  kernel.bins = bins;
+}
 
+void AudioFrequencyAnalysisBase::computeConstantQ()
+{
+  // each bin is the dot product of its kernel with the complex FFT bins, only a few entries per bin
+  const ConstantQKernel &kernel = *_cqKernel;
+  for (uint16_t k = 0; k < _cqBins; k++)
+  {
+    fft_acc_t sumReal = 0;
+    fft_acc_t sumImag = 0;
+    for (uint32_t e = kernel.start[k]; e < kernel.start[k + 1]; e++)
+    {
+      fft_t xr = _real[kernel.index[e]];
+      fft_t xi = _imag[kernel.index[e]];
+      sumReal += FFTMath<fft_t>::mul(xr, kernel.real[e]) - FFTMath<fft_t>::mul(xi, kernel.imag[e]);
+      sumImag += FFTMath<fft_t>::mul(xr, kernel.imag[e]) + FFTMath<fft_t>::mul(xi, kernel.real[e]);
+    }
+    _cqMagnitudes[k] = FFTMath<fft_t>::magnitude(FFTMath<fft_t>::narrow(sumReal), FFTMath<fft_t>::narrow(sumImag));
+  }
 }
 
-int AudioFrequencyAnalysis::getSampleSize()
+int AudioFrequencyAnalysisBase::getSampleSize()
 {
   return _sampleSize;
 }
 
-int AudioFrequencyAnalysis::getSampleRate()
+int AudioFrequencyAnalysisBase::getSampleCapacity()
+{
+  return _sampleCapacity;
+}
+
+uint8_t AudioFrequencyAnalysisBase::getRangeCapacity()
+{
+  return _rangeCapacity;
+}
+
+int AudioFrequencyAnalysisBase::getSampleRate()
 {
   return _sampleRate;
 }
 
-float *AudioFrequencyAnalysis::getReal()
+fft_t *AudioFrequencyAnalysisBase::getReal()
 {
   return _real;
 }
 
-float *AudioFrequencyAnalysis::getImaginary()
+fft_t *AudioFrequencyAnalysisBase::getImaginary()
 {
   return _imag;
 }
 
-void AudioFrequencyAnalysis::setNoiseFloor(float noiseFloor)
+void AudioFrequencyAnalysisBase::setNoiseFloor(float noiseFloor)
 {
   _noiseFloor = noiseFloor;
 }
 
 
-float AudioFrequencyAnalysis::mapAndClip(float x, float in_min, float in_max, float out_min, float out_max)
+float AudioFrequencyAnalysisBase::mapAndClip(float x, float in_min, float in_max, float out_min, float out_max)
 {
   if(in_max - in_min == 0) {
     in_max = 1; // divide by zero!
@@ -344,7 +1986,7 @@ float AudioFrequencyAnalysis::mapAndClip(float x, float in_min, float in_max, fl
 }
 
 
-void AudioFrequencyAnalysis::autoLevel(falloff_type falloffType, float falloffRate, float min, float max)
+void AudioFrequencyAnalysisBase::autoLevel(falloff_type falloffType, float falloffRate, float min, float max)
 {
   _isAutoLevel = falloffType != NO_FALLOFF;
   _sampleFalloffType = falloffType;
@@ -353,35 +1995,35 @@ void AudioFrequencyAnalysis::autoLevel(falloff_type falloffType, float falloffRa
   _autoMax = max;
 }
 
-bool AudioFrequencyAnalysis::isAutoLevel()
+bool AudioFrequencyAnalysisBase::isAutoLevel()
 {
   return _isAutoLevel;
 }
 
-float AudioFrequencyAnalysis::getSample(uint16_t index)
+float AudioFrequencyAnalysisBase::getSample(uint16_t index)
 {
   float value = 0;
   if (_samples)
   {
-    value = (float)_samples[index];
-    if (index < 0 || index >= _sampleSize)
+    value = 0;
+    if (index < _sampleSize)
     {
-      value = 0; // make zero
+      value = (float)readSample(index);
     }
   }
 
   return value; // raw value
 }
 
-float AudioFrequencyAnalysis::getSample(uint16_t index, float min, float max)
+float AudioFrequencyAnalysisBase::getSample(uint16_t index, float min, float max)
 {
   float value = 0;
   if (_samples)
   {
-    value = (float)_samples[index];
-    if (index < 0 || index >= _sampleSize)
+    value = 0;
+    if (index < _sampleSize)
     {
-      value = 0; // make zero
+      value = (float)readSample(index);
     }
   }
 
@@ -390,7 +2032,7 @@ float AudioFrequencyAnalysis::getSample(uint16_t index, float min, float max)
   return value;
 }
 
-uint16_t AudioFrequencyAnalysis::getSampleTriggerIndex()
+uint16_t AudioFrequencyAnalysisBase::getSampleTriggerIndex()
 {
   if (!_samples)
   {
@@ -399,8 +2041,8 @@ uint16_t AudioFrequencyAnalysis::getSampleTriggerIndex()
 #define ZERO_RANGE 0
   for (int i = 0; i < (_sampleSize/2 - 1); i++)
   {
-    float a = _samples[i];
-    float b = _samples[i + 1];
+    float a = readSample(i);
+    float b = readSample(i + 1);
     if (a >= ZERO_RANGE && b < -ZERO_RANGE)
     {
       return i;
@@ -409,43 +2051,168 @@ uint16_t AudioFrequencyAnalysis::getSampleTriggerIndex()
   return 0;
 }
 
-float AudioFrequencyAnalysis::getSampleMin()
+float AudioFrequencyAnalysisBase::getSampleMin()
 {
   return _samplesMin;
 }
 
-float AudioFrequencyAnalysis::getSampleMax()
+float AudioFrequencyAnalysisBase::getSampleMax()
 {
   return _samplesMax;
 }
 
 
 
+GoertzelRange::GoertzelRange(uint16_t hz, float bandwidthHz, float scaling) : FrequencyRange(hz, hz, scaling) {
+  _hz = hz;
+  _bandwidthHz = bandwidthHz;
+  _usesBins = false;
+}
+
+void GoertzelRange::begin(int sampleRate, int sampleSize) {
+  _sampleRate = sampleRate;
+  _blockSize = _bandwidthHz > 0 ? min((int)ceil(sampleRate / _bandwidthHz), 0xFFFF) : sampleSize;
+  if(_blockSize < 2) {
+    _blockSize = 2;
+  }
+  double w = TWO_PI * _hz / sampleRate;
+  _cos = FFTMath<fft_t>::fromDouble(cos(w));
+  _sin = FFTMath<fft_t>::fromDouble(sin(w));
+  _windowStep = FFTMath<fft_t>::fromDouble(cos(TWO_PI / _blockSize));
+  // the resonator grows up to blockSize / sin(w) times the input
+  double gain = _blockSize / max(fabs(sin(w)), 1.0 / _blockSize);
+  _shift = FFTMath<fft_t>::headroomShift > 0 ? min((int)ceil(log2(gain)), 31) : 0;
+  _count = 0;
+  _s1 = 0;
+  _s2 = 0;
+  _windowCos = FFTMath<fft_t>::fromDouble(1);
+  _windowPrev = _windowStep; // cos(-step)
+}
+
+template <typename sample_t>
+void GoertzelRange::process(sample_t *samples, int samplesLength) {
+  if(_generation != _audioInfo->_generation) {
+    // sample rate or size changed, a bandwidth of 0 follows the FFT bin width
+    _generation = _audioInfo->_generation;
+    begin(_audioInfo->_sampleRate, _audioInfo->_sampleSize);
+  }
+  for(int i = 0; i < samplesLength;) {
+    // s = x + 2cos(w)s1 - s2, one multiply per sample. block checks stay out of the inner loops
+    int end = i + min(samplesLength - i, (int)(_blockSize - _count));
+    _count += end - i;
+    fft_t s1 = _s1;
+    fft_t s2 = _s2;
+    if(_hamming) {
+      const fft_t hammingA = FFTMath<fft_t>::fromDouble(0.54);
+      const fft_t hammingB = FFTMath<fft_t>::fromDouble(0.46);
+      fft_t c = _windowCos;
+      fft_t cPrev = _windowPrev;
+      for(; i < end; i++) {
+        fft_t x = FFTMath<fft_t>::mul(FFTMath<fft_t>::down((fft_t)samples[i], _shift), hammingA - FFTMath<fft_t>::mul(c, hammingB));
+        fft_t t = FFTMath<fft_t>::mul(s1, _cos);
+        fft_t s = (x - s2) + t + t;
+        s2 = s1;
+        s1 = s;
+        // window phase by the same recurrence, cos(n + 1) = 2cos(step)cos(n) - cos(n - 1)
+        fft_t u = FFTMath<fft_t>::mul(c, _windowStep);
+        fft_t cNext = (u - cPrev) + u;
+        cPrev = c;
+        c = cNext;
+      }
+      _windowCos = c;
+      _windowPrev = cPrev;
+    }
+    else {
+      for(; i < end; i++) {
+        fft_t t = FFTMath<fft_t>::mul(s1, _cos);
+        fft_t s = (FFTMath<fft_t>::down((fft_t)samples[i], _shift) - s2) + t + t;
+        s2 = s1;
+        s1 = s;
+      }
+    }
+    _s1 = s1;
+    _s2 = s2;
+
+    if(_count < _blockSize) {
+      return;
+    }
+    // bin = s1 - s2 * e^-iw, same units as an FFT bin of blockSize samples
+    fft_t real = _s1 - FFTMath<fft_t>::mul(_s2, _cos);
+    fft_t imag = FFTMath<fft_t>::mul(_s2, _sin);
+    float magnitude = (float)FFTMath<fft_t>::magnitude(real, imag) * (float)((uint32_t)1 << _shift);
+    if(!_hamming) {
+      magnitude *= 0.54; // Hamming coherent gain, reads the same as a FrequencyRange on the FFT
+    }
+    update(magnitude / (float)(0xFFFF * 0xFF) * _scaling); // no bins, getMaxFrequency() is always _hz
+    _count = 0;
+    _s1 = 0;
+    _s2 = 0;
+    _windowCos = FFTMath<fft_t>::fromDouble(1);
+    _windowPrev = _windowStep; // cos(-step)
+  }
+}
+
 FrequencyRange::FrequencyRange(uint16_t lowHz, uint16_t highHz, float scaling) {
   _lowHz = lowHz;
   _highHz = highHz;
   _scaling = scaling;
 }
 
-void FrequencyRange::setAudioInfo(AudioFrequencyAnalysis *audioInfo) { // gets called from AudioFrequencyAnalysis::addFrequencyRange();
+FrequencyRange::~FrequencyRange() {
+  delete _maxRollingAverage;
+  delete _peakRollingAverage;
+}
+
+void FrequencyRange::setAudioInfo(AudioFrequencyAnalysisBase *audioInfo) { // gets called from AudioFrequencyAnalysisBase::addFrequencyRange();
   _audioInfo = audioInfo;
-  // Calculate FFT index from frequency.
-  float lowIndex = (float)(_lowHz * _audioInfo->_sampleSize) / (float)_audioInfo->_sampleRate;
-  float highIndex = (float)(_highHz * _audioInfo->_sampleSize) / (float)_audioInfo->_sampleRate;
-  if(highIndex-lowIndex <= 1.0) {
-    _startSampleIndex = floor(lowIndex);
-    _endSampleIndex = _startSampleIndex + 1;
+  if(_usesBins) {
+    reindex();
+  }
+}
+
+void FrequencyRange::reindex() { // gets called again whenever the analyzer _generation moved on
+  _generation = _audioInfo->_generation;
+  // bin k is centered on k and covers k - 0.5 .. k + 0.5
+  int bins = _audioInfo->getBinCount();
+  float maxIndex = bins - 0.5;
+  _lowBinIndex = _audioInfo->getBinIndex(_lowHz);
+  _highBinIndex = _audioInfo->getBinIndex(_highHz);
+  _lowBinIndex = _lowBinIndex > maxIndex ? maxIndex : _lowBinIndex;
+  _highBinIndex = _highBinIndex > maxIndex ? maxIndex : _highBinIndex;
+  _lowBinIndex = _lowBinIndex < -0.5 ? -0.5 : _lowBinIndex; // constant-Q bins start at minHz
+  float width = _highBinIndex - _lowBinIndex;
+  if(width < 0) {
+    _startSampleIndex = 0;
+    _endSampleIndex = 0;
+    return;
+  }
+  int first, last;
+  if(width < 1) {
+    // narrower than a bin, interpolate the two bins around the center
+    first = floor((_lowBinIndex + _highBinIndex) / 2);
+    last = first + 1;
+    first = first < 0 ? 0 : first;
   }
   else {
-    _startSampleIndex = round(lowIndex);
-    _endSampleIndex = round(highIndex);
+    // every bin that overlaps the range
+    first = floor(_lowBinIndex + 0.5);
+    last = ceil(_highBinIndex + 0.5) - 1;
+  }
+  if(last >= bins) {
+    last = bins - 1;
   }
+  _startSampleIndex = first;
+  _endSampleIndex = last + 1;
 }
 
-void FrequencyRange::loop() {
-  uint16_t offset = _startSampleIndex;
-  uint16_t end = _endSampleIndex - _startSampleIndex;
+void FrequencyRange::loop(float value, int16_t maxIndex) {
+  // value and max bin were calculated by AudioFrequencyAnalysis in one pass over all ranges
+  _maxIndex = maxIndex;
+  update(value);
+}
 
+void FrequencyRange::update(float value) {
+  AUDIO_PROFILE_SCOPE(AUDIO_STAGE_RANGE_LOOP);
   if(_maxFalloffType != ROLLING_AVERAGE_FALLOFF) {
     _maxFallRate = calculateFalloff(_maxFalloffType, _maxFalloffRate, _maxFallRate);
     _max -= _maxFallRate;
@@ -475,42 +2242,15 @@ void FrequencyRange::loop() {
     _peakRollingAverage = new RollingAverage();
   }
 
-  // reset value
-  _value = 0;
-  _maxIndex = -1;
-  float maxRv = 0;
-
-  for (int i = _startSampleIndex; i < _endSampleIndex; i++)
-  {
-    // scale down factor to prevent overflow
-    float rv = (_audioInfo->_real[i] / (float)(0xFFFF * 0xFF));
-    float iv = (_audioInfo->_imag[i] / (float)(0xFFFF * 0xFF));
-    // some smoothing with imaginary numbers.
-    rv = sqrt(rv * rv + iv * iv);
-    // apply eq scaling
-    rv = rv * _scaling;
-
-    rv = rv < _audioInfo->_noiseFloor ? 0 : rv;
-
-    if(_highFrequencyRollOffCompensation > 0) {
-      uint16_t frequency = (i * _audioInfo->_sampleRate) / _audioInfo->_sampleSize;
-      rv = rv * pow(frequency, _highFrequencyRollOffCompensation);
-    }
-
-    if(rv > maxRv) {
-      maxRv = rv;
-      _maxIndex = i;
-    }
-    // combine band amplitudes for current band segment
-    _value += rv;
-
-  }
+  float last = _value;
+  _value = value;
 
   // remove noise
   if (_value < _audioInfo->_noiseFloor)
   {
     _value = 0;
   }
+  _slope += 0.5f * ((_value - last) - _slope);
 
   if(_peakFalloffType == ROLLING_AVERAGE_FALLOFF) {
     float _temp = _peak;
@@ -563,6 +2303,13 @@ void FrequencyRange::loop() {
   }
 }
 
+bool FrequencyRange::binsChanged() {
+  if(!_usesBins) {
+    return false;
+  }
+  return _generation != _audioInfo->_generation || _lowHz != _tableLowHz || _highHz != _tableHighHz || _highFrequencyRollOffCompensation != _tableRollOffCompensation;
+}
+
 float FrequencyRange::getMin() {
   return _min; // raw value
 }
@@ -572,10 +2319,13 @@ float FrequencyRange::getMax() {
 }
 
 uint16_t FrequencyRange::getMaxFrequency() {
+  if(!_usesBins) {
+    return (_lowHz + _highHz) / 2; // GoertzelRange only measures its target
+  }
   if(_maxIndex == -1) {
     return 0;
   }
-  return (_maxIndex * _audioInfo->_sampleRate) / _audioInfo->_sampleSize;
+  return _audioInfo->getBinFrequency(_maxIndex);
 }
 
 float FrequencyRange::getValue(float min, float max) {
@@ -606,6 +2356,74 @@ float FrequencyRange::getPeak() {
   return _peak;
 }
 
+float FrequencyRange::getPredictedValue(float seconds) {
+  if(seconds < 0) {
+    seconds = _audioInfo->getLatency();
+  }
+  float step = loopSeconds();
+  if(step <= 0) {
+    return _value; // no frame yet
+  }
+  // linear from the smoothed slope, no lower than silence and no higher than the range has been
+  float value = _value + _slope * seconds / step;
+  return value < 0 ? 0 : min(value, max(_value, _max));
+}
+
+float FrequencyRange::getPredictedValue(float min, float max, float seconds) {
+  float value = getPredictedValue(seconds);
+  if(!_inIsolation) {
+    return mapAndClip(value, 0, _audioInfo->_max, min, max);
+  }
+  // normalize _min/_max
+  return mapAndClip(value, 0, _max, min, max);
+}
+
+float FrequencyRange::loopSeconds() {
+  if(!_usesBins) {
+    GoertzelRange *goertzel = (GoertzelRange *)this;
+    if(goertzel->_sampleRate > 0) {
+      return (float)goertzel->_blockSize / goertzel->_sampleRate; // one value per block
+    }
+  }
+  int step = _audioInfo->getFrameStep();
+  int sampleRate = _audioInfo->getSampleRate();
+  return sampleRate > 0 ? (float)(step > 0 ? step : _audioInfo->getSampleSize()) / sampleRate : 0;
+}
+
+float FrequencyRange::getDBFS() {
+  return _audioInfo->toDBFS(_level.power);
+}
+
+float FrequencyRange::getDBSPL() {
+  return _audioInfo->toDBSPL(_level.power);
+}
+
+float FrequencyRange::getLeq() {
+  return _audioInfo->toDBSPL(_level.leq);
+}
+
+ConstantQKernel::~ConstantQKernel()
+{
+  delete[] start;
+  delete[] index;
+  delete[] real;
+  delete[] imag;
+}
+
+void SoundLevel::add(float framePower, float frameSeconds, float period)
+{
+  // energy average, every frame counts for the time it moved on by
+  power = framePower;
+  energy += framePower * frameSeconds;
+  seconds += frameSeconds;
+  if (seconds >= period && seconds > 0)
+  {
+    leq = energy / seconds;
+    energy = 0;
+    seconds = 0;
+  }
+}
+
 float FrequencyRange::mapAndClip(float x, float in_min, float in_max, float out_min, float out_max)
 {
   if(in_max - in_min == 0) {
@@ -1,23 +1,95 @@
 #ifndef AudioInI2S_H
 #define AudioInI2S_H
 
-#include "Arduino.h"
+#include "AudioPlatform.h"
+
+#ifndef ARDUINO
+#include "AudioInI2SHost.h" // same class, reading WAV/raw files or a generator
+#else
+
 #include <driver/i2s.h>
+#include <type_traits>
+#include <atomic>
+#include "SampleRingBuffer.h"
+#include "AudioSample.h"
+#include "AudioProfiler.h"
 
 /*
     AudioInI2S.h
     By Shea Ivey
 
     https://github.com/sheaivey/ESP32-AudioInI2S
+
+    AudioInI2S captures int32_t samples. AudioInI2ST<sample16_t> captures 16 bit samples
+    (half the DMA, ring and sample buffer memory), AudioInI2ST<sample24_t> packs 24 bits into
+    3 bytes. The analyzers take every type directly, see AudioSample.h.
+
+    I2S_CHANNEL_FMT_RIGHT_LEFT captures two microphones on one data pin (L/R of one tied to
+    GND, the other to VDD). The DMA buffers hold left/right pairs, read(left, right) splits
+    them into one buffer per channel while copying them out.
 */
 
-class AudioInI2S
+// DMA word of each sample type. The I2S peripheral has no packed 24 bit mode, so sample24_t
+// is captured in 32 bit words and packed while copying out of the DMA buffers.
+template <typename sample_type>
+struct I2SSampleFormat
 {
+  typedef int32_t word_t;
+  static const i2s_bits_per_sample_t bits = I2S_BITS_PER_SAMPLE_32BIT;
+  static void fix(word_t *words, int length) {}
+  static sample_type toSample(word_t word) { return sample_type(word); }
+};
+
+template <>
+struct I2SSampleFormat<sample16_t>
+{
+  typedef int16_t word_t;
+  static const i2s_bits_per_sample_t bits = I2S_BITS_PER_SAMPLE_16BIT; // MSB first, the mic's top 16 bits
+  static void fix(word_t *words, int length)
+  {
+#if CONFIG_IDF_TARGET_ESP32
+    // the original ESP32 stores 16 bit single channel samples in swapped pairs
+    for (int i = 0; i + 1 < length; i += 2)
+    {
+      word_t t = words[i];
+      words[i] = words[i + 1];
+      words[i + 1] = t;
+    }
+#endif
+  }
+  static sample16_t toSample(word_t word) // already the top 16 bits
+  {
+    sample16_t sample;
+    sample.value = word;
+    return sample;
+  }
+};
+
+template <typename sample_type = int32_t>
+class AudioInI2ST
+{
+  static_assert(std::is_same<sample_type, int32_t>::value || std::is_same<sample_type, sample24_t>::value || std::is_same<sample_type, sample16_t>::value,
+                "AudioInI2ST captures int32_t, sample24_t or sample16_t, other types would keep the low bits of the 32 bit mic words");
+
 public:
-  AudioInI2S(int bck_pin, int ws_pin, int data_pin, int channel_pin = -1, i2s_channel_fmt_t channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT);
-  void read(int32_t _samples[]);
-  // void readBuffered(int32_t _samples[], uint16_t len = 255); // Experimental stream samples buffer
-  void begin(int sample_size, int sample_rate = 44100, i2s_port_t i2s_port_number = I2S_NUM_0);
+  AudioInI2ST(int bck_pin, int ws_pin, int data_pin, int channel_pin = -1, i2s_channel_fmt_t channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT);
+  int read(sample_type _samples[]);             // reads a full sample_size buffer, returns the samples read. 0 while a stream task owns the DMA, use readAvailable()
+  int read(sample_type _samples[], int length); // reads length samples (e.g. one hop for AudioFrequencyAnalysis::stream()), returns the samples read
+  int read(sample_type left[], sample_type right[]);             // stereo, reads a full sample_size buffer per channel, returns the samples read per channel
+  int read(sample_type left[], sample_type right[], int length); // stereo, reads length samples per channel, returns the samples read per channel
+  bool isStereo();                                               // channel_format is I2S_CHANNEL_FMT_RIGHT_LEFT
+  void begin(int sample_size, int sample_rate = 44100, i2s_port_t i2s_port_number = I2S_NUM_0, int dma_buf_count = 4, int dma_buf_len = 0); // dma_buf_len 0 = sample_size
+  bool setSampleRate(int sample_rate); // changes the rate after begin(), the DMA buffers are cleared
+  int getSampleRate();                 // gets the current sample rate
+  int getLatency();                    // samples a sound waits before read() returns it, half a DMA buffer plus what is queued in the stream ring
+
+  /* Streaming Functions */
+  bool beginStream(int ring_size = 0, int core = 0); // moves every finished DMA buffer into a ring. ring_size 0 = dma_buf_count * dma_buf_len, per channel.
+                                                     // core -1 = no task, DMA buffers are moved during available()/readAvailable()
+  int available();                                   // samples ready to read without blocking, per channel
+  int readAvailable(sample_type _samples[], int length); // reads up to length samples without blocking, returns the samples read
+  int readAvailable(sample_type left[], sample_type right[], int length); // stereo, reads up to length samples per channel without blocking
+  uint32_t getOverruns();                            // DMA buffers dropped because the ring was full
 
 private:
   int _bck_pin;
@@ -29,10 +101,22 @@ private:
   int _sample_rate;
   i2s_port_t _i2s_port_number;
 
+  SampleRingBuffer<sample_type> _ring;
+  sample_type *_dma_chunk = nullptr;
+  TaskHandle_t _stream_task = nullptr;
+  std::atomic<bool> _streaming{false}; // set before the stream task starts, the task may run before xTaskCreatePinnedToCore() fills in its handle
+  QueueHandle_t _i2s_queue = nullptr; // driver events, only installed with AUDIO_PROFILE to count dropped buffers
+  int readDMA(sample_type _samples[], int length, TickType_t ticks_to_wait); // i2s_read() in the sample type, returns the samples read
+  int readDMA(sample_type left[], sample_type right[], int length, TickType_t ticks_to_wait); // i2s_read() of left/right pairs into two buffers, returns the pairs read
+  int channels();   // samples per I2S frame, 2 for stereo
+  void countDrops(); // dropped DMA buffers from the driver events
+  void pump(TickType_t ticks_to_wait); // moves finished DMA buffers into the ring
+  static void streamTask(void *param);
+
   i2s_config_t _i2s_config = {
       .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
       .sample_rate = 0, // set in begin()
-      .bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT, // TODO: let user decide what sample type to use (class type template)
+      .bits_per_sample = I2SSampleFormat<sample_type>::bits,
       .channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT,
       .communication_format = I2S_COMM_FORMAT_I2S,
       .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
@@ -51,7 +135,8 @@ private:
   };
 };
 
-AudioInI2S::AudioInI2S(int bck_pin, int ws_pin, int data_pin, int channel_pin, i2s_channel_fmt_t channel_format)
+template <typename sample_type>
+AudioInI2ST<sample_type>::AudioInI2ST(int bck_pin, int ws_pin, int data_pin, int channel_pin, i2s_channel_fmt_t channel_format)
 {
   _bck_pin = bck_pin;
   _ws_pin = ws_pin;
@@ -60,9 +145,10 @@ AudioInI2S::AudioInI2S(int bck_pin, int ws_pin, int data_pin, int channel_pin, i
   _channel_format = channel_format;
 }
 
-void AudioInI2S::begin(int sample_size, int sample_rate, i2s_port_t i2s_port_number)
+template <typename sample_type>
+void AudioInI2ST<sample_type>::begin(int sample_size, int sample_rate, i2s_port_t i2s_port_number, int dma_buf_count, int dma_buf_len)
 {
-  if (_channel_pin >= 0)
+  if (_channel_pin >= 0 && !isStereo())
   {
     pinMode(_channel_pin, OUTPUT);
     digitalWrite(_channel_pin, _channel_format == I2S_CHANNEL_FMT_ONLY_RIGHT ? LOW : HIGH);
@@ -77,41 +163,302 @@ void AudioInI2S::begin(int sample_size, int sample_rate, i2s_port_t i2s_port_num
   _i2s_mic_pins.data_in_num = _data_pin;
 
   _i2s_config.sample_rate = _sample_rate;
-  _i2s_config.dma_buf_len = _sample_size;
+  _i2s_config.dma_buf_count = dma_buf_count;
+  _i2s_config.dma_buf_len = dma_buf_len > 0 ? dma_buf_len : _sample_size;
   _i2s_config.channel_format = _channel_format;
 
   // start up the I2S peripheral
+#ifdef AUDIO_PROFILE
+  i2s_driver_install(_i2s_port_number, &_i2s_config, dma_buf_count, &_i2s_queue);
+#else
   i2s_driver_install(_i2s_port_number, &_i2s_config, 0, NULL);
+#endif
   i2s_set_pin(_i2s_port_number, &_i2s_mic_pins);
 }
 
-void AudioInI2S::read(int32_t _samples[])
+template <typename sample_type>
+bool AudioInI2ST<sample_type>::setSampleRate(int sample_rate)
+{
+  if (sample_rate == _sample_rate)
+  {
+    return true;
+  }
+  if (i2s_set_sample_rates(_i2s_port_number, sample_rate) != ESP_OK)
+  {
+    return false;
+  }
+  _sample_rate = sample_rate;
+  _i2s_config.sample_rate = sample_rate;
+  return true;
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::getSampleRate()
 {
+  return _sample_rate;
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::getLatency()
+{
+  // a sample waits for the rest of its DMA buffer, half a buffer on average, then for the reader to catch up with the ring
+  int queued = _dma_chunk != nullptr ? _ring.available() / channels() : 0;
+  return _i2s_config.dma_buf_len / 2 + queued;
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::read(sample_type _samples[])
+{
+  return read(_samples, _sample_size);
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::read(sample_type _samples[], int length)
+{
+  if (_streaming)
+  {
+    return 0; // the stream task owns the DMA buffers
+  }
   // copy I2S data into the samples buffer
+  int samples_read = 0;
+  {
+    AUDIO_PROFILE_SCOPE(AUDIO_STAGE_I2S_WAIT);
+    samples_read = readDMA(_samples, length, portMAX_DELAY);
+  }
+  countDrops();
+  return samples_read;
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::read(sample_type left[], sample_type right[])
+{
+  return read(left, right, _sample_size);
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::read(sample_type left[], sample_type right[], int length)
+{
+  if (_streaming)
+  {
+    return 0; // the stream task owns the DMA buffers
+  }
+  int samples_read = 0;
+  {
+    AUDIO_PROFILE_SCOPE(AUDIO_STAGE_I2S_WAIT);
+    samples_read = readDMA(left, right, length, portMAX_DELAY);
+  }
+  countDrops();
+  return samples_read;
+}
+
+template <typename sample_type>
+bool AudioInI2ST<sample_type>::isStereo()
+{
+  return _channel_format == I2S_CHANNEL_FMT_RIGHT_LEFT;
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::channels()
+{
+  return isStereo() ? 2 : 1;
+}
+
+template <typename sample_type>
+void AudioInI2ST<sample_type>::countDrops()
+{
+#ifdef AUDIO_PROFILE
+  i2s_event_t event;
+  while (_i2s_queue != nullptr && xQueueReceive(_i2s_queue, &event, 0) == pdTRUE)
+  {
+    if (event.type == I2S_EVENT_RX_Q_OVF)
+    {
+      AUDIO_PROFILE_DROPS(1); // the driver dropped the oldest DMA buffer
+    }
+  }
+#endif
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::readDMA(sample_type _samples[], int length, TickType_t ticks_to_wait)
+{
+  typedef typename I2SSampleFormat<sample_type>::word_t word_t;
   size_t bytes_read = 0;
-  i2s_read(_i2s_port_number, _samples, sizeof(int32_t) * _sample_size, &bytes_read, portMAX_DELAY);
-  int samples_read = bytes_read / sizeof(int32_t);
+  if (sizeof(word_t) == sizeof(sample_type))
+  {
+    // DMA words are the samples
+    i2s_read(_i2s_port_number, _samples, sizeof(word_t) * length, &bytes_read, ticks_to_wait);
+    int samples_read = bytes_read / sizeof(word_t);
+    I2SSampleFormat<sample_type>::fix((word_t *)_samples, samples_read);
+    return samples_read;
+  }
+  // packed types are converted while copying out of the DMA buffers
+  word_t words[64];
+  int count = 0;
+  while (count < length)
+  {
+    int chunk = min(length - count, 64);
+    i2s_read(_i2s_port_number, words, sizeof(word_t) * chunk, &bytes_read, ticks_to_wait);
+    int samples_read = bytes_read / sizeof(word_t);
+    for (int i = 0; i < samples_read; i++)
+    {
+      _samples[count + i] = I2SSampleFormat<sample_type>::toSample(words[i]);
+    }
+    count += samples_read;
+    if (samples_read < chunk)
+    {
+      break;
+    }
+  }
+  return count;
 }
 
-/* // Experimental stream samples buffer
-void AudioInI2S::readBuffered(int32_t _samples[], uint16_t len)
+template <typename sample_type>
+int AudioInI2ST<sample_type>::readDMA(sample_type left[], sample_type right[], int length, TickType_t ticks_to_wait)
 {
-  // stream I2S data into the samples buffer
-  int32_t raw[len];
+  // pairs are split while copying out of the DMA buffers, left is the first word of every frame
+  typedef typename I2SSampleFormat<sample_type>::word_t word_t;
   size_t bytes_read = 0;
-  i2s_read(_i2s_port_number, raw, sizeof(int32_t) * len, &bytes_read, portMAX_DELAY);
-  int samples_read = bytes_read / sizeof(int32_t);
-  // shift data to left
-  for (int j = 0; j < (_sample_size - samples_read); j++)
+  word_t words[64];
+  int count = 0;
+  while (count < length)
+  {
+    int chunk = min(length - count, 32);
+    i2s_read(_i2s_port_number, words, sizeof(word_t) * 2 * chunk, &bytes_read, ticks_to_wait);
+    int pairs_read = bytes_read / (sizeof(word_t) * 2);
+    I2SSampleFormat<sample_type>::fix(words, pairs_read * 2);
+    for (int i = 0; i < pairs_read; i++)
+    {
+      left[count + i] = I2SSampleFormat<sample_type>::toSample(words[2 * i]);
+      right[count + i] = I2SSampleFormat<sample_type>::toSample(words[2 * i + 1]);
+    }
+    count += pairs_read;
+    if (pairs_read < chunk)
+    {
+      break;
+    }
+  }
+  return count;
+}
+
+template <typename sample_type>
+bool AudioInI2ST<sample_type>::beginStream(int ring_size, int core)
+{
+  if (_dma_chunk != nullptr)
   {
-    _samples[j] = _samples[j + samples_read];
+    return true; // already streaming
   }
-  // copy raw to end
-  for (int j = (_sample_size - samples_read), p = 0; j < _sample_size; j++, p++)
+  if (ring_size <= 0)
   {
-    _samples[j] = raw[p];
+    ring_size = _i2s_config.dma_buf_count * _i2s_config.dma_buf_len;
   }
+  _ring.begin(ring_size * channels()); // stereo rings hold left/right pairs
+  _dma_chunk = new sample_type[_i2s_config.dma_buf_len * channels()];
+  if (core < 0)
+  {
+    return true; // polled from available()/readAvailable()
+  }
+  _streaming = true; // before the task runs, or available() could pump the ring from a second producer
+  if (xTaskCreatePinnedToCore(streamTask, "AudioInI2S", 2048, this, configMAX_PRIORITIES - 1, &_stream_task, core) != pdPASS)
+  {
+    _streaming = false; // fall back to polling
+    return false;
+  }
+  return true;
 }
-*/
+
+template <typename sample_type>
+void AudioInI2ST<sample_type>::streamTask(void *param)
+{
+  AudioInI2ST *mic = (AudioInI2ST *)param;
+  for (;;)
+  {
+    mic->pump(portMAX_DELAY); // wakes up once per finished DMA buffer
+  }
+}
+
+template <typename sample_type>
+void AudioInI2ST<sample_type>::pump(TickType_t ticks_to_wait)
+{
+  int buffer_length = _i2s_config.dma_buf_len * channels();
+  int samples_read = 0;
+  do
+  {
+    samples_read = readDMA(_dma_chunk, buffer_length, ticks_to_wait);
+    if (samples_read > 0 && _ring.write(_dma_chunk, samples_read) == 0)
+    {
+      AUDIO_PROFILE_DROPS(1); // ring full
+    }
+    ticks_to_wait = 0; // drain whatever else is ready
+  } while (samples_read == buffer_length && !_streaming);
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::available()
+{
+  if (_dma_chunk == nullptr)
+  {
+    return 0;
+  }
+  if (!_streaming)
+  {
+    pump(0);
+  }
+  return _ring.available() / channels();
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::readAvailable(sample_type _samples[], int length)
+{
+  if (_dma_chunk == nullptr)
+  {
+    return 0;
+  }
+  if (!_streaming)
+  {
+    pump(0);
+  }
+  return _ring.read(_samples, length);
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::readAvailable(sample_type left[], sample_type right[], int length)
+{
+  if (_dma_chunk == nullptr)
+  {
+    return 0;
+  }
+  if (!_streaming)
+  {
+    pump(0);
+  }
+  // whole DMA buffers go into the ring so it always holds complete pairs
+  sample_type pairs[64];
+  int count = 0;
+  while (count < length)
+  {
+    int pairs_read = _ring.read(pairs, 2 * min(length - count, 32)) / 2;
+    for (int i = 0; i < pairs_read; i++)
+    {
+      left[count + i] = pairs[2 * i];
+      right[count + i] = pairs[2 * i + 1];
+    }
+    count += pairs_read;
+    if (pairs_read == 0)
+    {
+      break;
+    }
+  }
+  return count;
+}
+
+template <typename sample_type>
+uint32_t AudioInI2ST<sample_type>::getOverruns()
+{
+  return _ring.getOverruns();
+}
+
+typedef AudioInI2ST<> AudioInI2S;
+
+#endif // ARDUINO
 
 #endif // AudioInI2S_H
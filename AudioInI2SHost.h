@@ -0,0 +1,708 @@
+#ifndef AudioInI2SHost_H
+#define AudioInI2SHost_H
+
+#include "AudioPlatform.h"
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+#include "SampleRingBuffer.h"
+#include "AudioSample.h"
+#include "AudioProfiler.h"
+
+/*
+    AudioInI2SHost.h
+    By Shea Ivey
+
+    https://github.com/sheaivey/ESP32-AudioInI2S
+
+    AudioInI2S for builds without ARDUINO (Linux, macOS), included by AudioInI2S.h.
+    Same public functions as the ESP32 class so sketches and AudioPipeline build unchanged,
+    the pins are ignored and the samples come from a WAV file, raw PCM file or a generator.
+    Samples are delivered like the INMP441 delivers them: left aligned in 32 bits, so full
+    scale is +-2^31 whatever the bit depth of the source. AudioInI2ST<sample16_t> and
+    AudioInI2ST<sample24_t> keep the top 16/24 bits like the device does.
+    I2S_CHANNEL_FMT_RIGHT_LEFT keeps both channels of a stereo file for read(left, right),
+    mono files and generators play on both.
+
+    With setRealtime(true) (the default) read() waits until the samples would have arrived at
+    the begin() sample rate, so timings match the device. setRealtime(false) runs as fast as
+    the analysis allows, for offline processing. No resampling is done, getSourceSampleRate()
+    is the rate the file was recorded at.
+
+    The source (file, generator, clock) may be changed from another thread while beginStream()
+    runs its thread, the thread holds _source_lock only while it makes a buffer.
+*/
+
+#ifndef I2S_NUM_0
+typedef int i2s_port_t;
+enum
+{
+  I2S_NUM_0 = 0,
+  I2S_NUM_1 = 1
+};
+typedef enum
+{
+  I2S_CHANNEL_FMT_RIGHT_LEFT,
+  I2S_CHANNEL_FMT_ALL_RIGHT,
+  I2S_CHANNEL_FMT_ALL_LEFT,
+  I2S_CHANNEL_FMT_ONLY_RIGHT,
+  I2S_CHANNEL_FMT_ONLY_LEFT
+} i2s_channel_fmt_t;
+#endif
+
+template <typename sample_type = int32_t>
+class AudioInI2ST
+{
+  static_assert(std::is_same<sample_type, int32_t>::value || std::is_same<sample_type, sample24_t>::value || std::is_same<sample_type, sample16_t>::value,
+                "AudioInI2ST captures int32_t, sample24_t or sample16_t, other types would keep the low bits of the 32 bit mic words");
+
+public:
+  AudioInI2ST(int bck_pin = -1, int ws_pin = -1, int data_pin = -1, int channel_pin = -1, i2s_channel_fmt_t channel_format = I2S_CHANNEL_FMT_ONLY_RIGHT);
+  ~AudioInI2ST();
+  int read(sample_type _samples[]);             // reads a full sample_size buffer, returns the samples read. 0 while a stream thread owns the source, use readAvailable()
+  int read(sample_type _samples[], int length); // reads length samples, returns the samples read (0 once a source that does not loop has ended)
+  int read(sample_type left[], sample_type right[]);             // stereo, reads a full sample_size buffer per channel, returns the samples read per channel
+  int read(sample_type left[], sample_type right[], int length); // stereo, reads length samples per channel, returns the samples read per channel
+  bool isStereo();                                               // channel_format is I2S_CHANNEL_FMT_RIGHT_LEFT
+  void begin(int sample_size, int sample_rate = 44100, i2s_port_t i2s_port_number = I2S_NUM_0, int dma_buf_count = 4, int dma_buf_len = 0); // dma_buf_len 0 = sample_size
+  bool setSampleRate(int sample_rate); // changes the rate after begin(), files are not resampled
+  int getSampleRate();                 // gets the current sample rate
+  int getLatency();                    // samples a sound waits before read() returns it, half a DMA buffer plus what is queued in the stream ring
+
+  /* Streaming Functions */
+  bool beginStream(int ring_size = 0, int core = 0); // ring_size per channel. core >= 0 fills the ring from a thread, core -1 = filled during available()/readAvailable()
+  int available();                                   // samples ready to read without blocking, per channel
+  int readAvailable(sample_type _samples[], int length); // reads up to length samples without blocking, returns the samples read
+  int readAvailable(sample_type left[], sample_type right[], int length); // stereo, reads up to length samples per channel without blocking
+  uint32_t getOverruns();                            // DMA buffers dropped because the ring was full
+
+  /* Host Functions */
+  bool openWav(const char *path, bool loop = false);                             // PCM 8/16/24/32 bit or 32 bit float, the channel follows channel_format, stereo keeps the first two
+  bool openRaw(const char *path, int bits = 16, int channels = 1, bool loop = false); // signed little endian PCM without a header
+  void generate(float (*generator)(uint32_t index, int sample_rate));           // generator returns -1 to 1 for every sample index
+  void close();                                                                  // back to silence
+  void setRealtime(bool realtime = true);                                        // pace reads at the sample rate
+  bool isEnd();                                                                  // the file ended and does not loop
+  int getSourceSampleRate();                                                     // rate stored in the WAV file, 0 for raw files and generators
+
+private:
+  enum source_type
+  {
+    SOURCE_SILENCE,
+    SOURCE_FILE,
+    SOURCE_GENERATOR
+  };
+
+  int _channel_pin;
+  i2s_channel_fmt_t _channel_format;
+  int _sample_size = 0;
+  int _sample_rate = 44100;
+  int _dma_buf_count = 4;
+  int _dma_buf_len = 0;
+
+  source_type _source = SOURCE_SILENCE;
+  FILE *_file = nullptr;
+  long _data_start = 0;    // file offset of the first frame
+  uint32_t _data_size = 0; // bytes of sample data, 0 = until the end of the file
+  uint32_t _data_read = 0;
+  uint8_t _format = 1;     // 1 = PCM, 3 = float
+  uint8_t _bytes = 2;      // per sample
+  uint8_t _channels = 1;
+  uint8_t _channel = 0;    // the channel that is kept, left in stereo
+  int _source_rate = 0;
+  bool _loop = false;
+  std::atomic<bool> _end{false};
+  float (*_generator)(uint32_t index, int sample_rate) = nullptr;
+  uint32_t _index = 0;     // frames produced so far
+
+  bool _realtime = true;
+  std::chrono::steady_clock::time_point _clock_start;
+  uint64_t _clock_samples = 0; // frames released since _clock_start
+
+  SampleRingBuffer<sample_type> _ring;
+  sample_type *_dma_chunk = nullptr;
+  std::thread *_stream_thread = nullptr;
+  std::atomic<bool> _streaming{false};
+  std::mutex _source_lock; // guards the source and the clock between the stream thread and the caller
+
+  bool openFile(const char *path, bool loop); // _source_lock held
+  bool parseWav();                             // _source_lock held
+  void closeSource();                          // _source_lock held
+  int produce(int32_t _samples[], int length); // next length samples from the source, left/right pairs in stereo, _source_lock held
+  int produceAs(sample_type _samples[], int length); // produce() in the sample type, _source_lock held
+  int32_t decode(const uint8_t *bytes);        // one file sample, left aligned
+  int channels();                              // samples per frame, 2 for stereo
+  void waitFor(int length);                    // blocks until length more frames are due
+  int due();                                   // frames due by the clock that were not released yet, _source_lock held
+  void pump(bool wait);                        // moves finished "DMA buffers" into the ring
+  void streamThread();
+};
+
+template <typename sample_type>
+AudioInI2ST<sample_type>::AudioInI2ST(int /* bck_pin */, int /* ws_pin */, int /* data_pin */, int channel_pin, i2s_channel_fmt_t channel_format)
+{
+  _channel_pin = channel_pin;
+  _channel_format = channel_format;
+}
+
+template <typename sample_type>
+AudioInI2ST<sample_type>::~AudioInI2ST()
+{
+  if (_stream_thread != nullptr)
+  {
+    _streaming = false;
+    _stream_thread->join();
+    delete _stream_thread;
+  }
+  delete[] _dma_chunk;
+  close(); // the thread is gone, nothing reads the file any more
+}
+
+template <typename sample_type>
+void AudioInI2ST<sample_type>::begin(int sample_size, int sample_rate, i2s_port_t /* i2s_port_number */, int dma_buf_count, int dma_buf_len)
+{
+  std::lock_guard<std::mutex> lock(_source_lock);
+  _sample_size = sample_size;
+  _sample_rate = sample_rate;
+  _dma_buf_count = dma_buf_count;
+  _dma_buf_len = dma_buf_len > 0 ? dma_buf_len : _sample_size;
+  _clock_start = std::chrono::steady_clock::now();
+  _clock_samples = 0;
+}
+
+template <typename sample_type>
+bool AudioInI2ST<sample_type>::setSampleRate(int sample_rate)
+{
+  if (sample_rate <= 0)
+  {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(_source_lock);
+  _sample_rate = sample_rate;
+  _clock_start = std::chrono::steady_clock::now();
+  _clock_samples = 0;
+  return true;
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::getSampleRate()
+{
+  std::lock_guard<std::mutex> lock(_source_lock);
+  return _sample_rate;
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::getLatency()
+{
+  // a sample waits for the rest of its DMA buffer, half a buffer on average, then for the reader to catch up with the ring
+  int queued = _dma_chunk != nullptr ? _ring.available() / channels() : 0;
+  return _dma_buf_len / 2 + queued;
+}
+
+template <typename sample_type>
+bool AudioInI2ST<sample_type>::openWav(const char *path, bool loop)
+{
+  std::lock_guard<std::mutex> lock(_source_lock);
+  if (!openFile(path, loop))
+  {
+    return false;
+  }
+  if (!parseWav())
+  {
+    closeSource();
+    return false;
+  }
+  return true;
+}
+
+template <typename sample_type>
+bool AudioInI2ST<sample_type>::parseWav()
+{
+  // RIFF header then chunks, only "fmt " and "data" matter
+  uint8_t header[12];
+  if (fread(header, 1, 12, _file) != 12 || memcmp(header, "RIFF", 4) != 0 || memcmp(&header[8], "WAVE", 4) != 0)
+  {
+    return false;
+  }
+  bool hasFormat = false;
+  uint8_t chunk[8];
+  while (fread(chunk, 1, 8, _file) == 8)
+  {
+    uint32_t size = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((uint32_t)chunk[7] << 24);
+    if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16)
+    {
+      uint8_t fmt[40] = {0};
+      uint32_t length = size < sizeof(fmt) ? size : sizeof(fmt);
+      if (fread(fmt, 1, length, _file) != length)
+      {
+        break;
+      }
+      fseek(_file, (long)(size - length + (size & 1)), SEEK_CUR);
+      uint16_t format = fmt[0] | (fmt[1] << 8);
+      if (format == 0xFFFE && length >= 26)
+      {
+        format = fmt[24] | (fmt[25] << 8); // WAVE_FORMAT_EXTENSIBLE, sub format GUID starts with the tag
+      }
+      _format = format;
+      _channels = fmt[2] | (fmt[3] << 8);
+      _source_rate = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | ((uint32_t)fmt[7] << 24);
+      _bytes = (fmt[14] | (fmt[15] << 8)) / 8;
+      hasFormat = true;
+    }
+    else if (memcmp(chunk, "data", 4) == 0 && hasFormat)
+    {
+      bool supported = _channels > 0 && (_format == 1 ? _bytes >= 1 && _bytes <= 4 : _format == 3 && _bytes == 4);
+      if (!supported)
+      {
+        break;
+      }
+      _data_start = ftell(_file);
+      _data_size = size;
+      _channel = _channels > 1 && _channel_format == I2S_CHANNEL_FMT_ONLY_RIGHT ? 1 : 0; // WAV stores left first
+      return true;
+    }
+    else
+    {
+      fseek(_file, (long)(size + (size & 1)), SEEK_CUR); // chunks are word aligned
+    }
+  }
+  return false;
+}
+
+template <typename sample_type>
+bool AudioInI2ST<sample_type>::openRaw(const char *path, int bits, int channels, bool loop)
+{
+  if (bits < 8 || bits > 32 || bits % 8 != 0 || channels < 1)
+  {
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(_source_lock);
+  if (!openFile(path, loop))
+  {
+    return false;
+  }
+  _format = 1;
+  _bytes = bits / 8;
+  _channels = channels;
+  _channel = _channels > 1 && _channel_format == I2S_CHANNEL_FMT_ONLY_RIGHT ? 1 : 0;
+  _data_start = 0;
+  _data_size = 0;
+  _source_rate = 0;
+  return true;
+}
+
+template <typename sample_type>
+bool AudioInI2ST<sample_type>::openFile(const char *path, bool loop)
+{
+  closeSource();
+  _file = fopen(path, "rb");
+  if (_file == nullptr)
+  {
+    return false;
+  }
+  _source = SOURCE_FILE;
+  _loop = loop;
+  _end = false;
+  _data_read = 0;
+  _index = 0;
+  return true;
+}
+
+template <typename sample_type>
+void AudioInI2ST<sample_type>::generate(float (*generator)(uint32_t index, int sample_rate))
+{
+  std::lock_guard<std::mutex> lock(_source_lock);
+  closeSource();
+  _generator = generator;
+  _source = generator != nullptr ? SOURCE_GENERATOR : SOURCE_SILENCE;
+  _index = 0;
+}
+
+template <typename sample_type>
+void AudioInI2ST<sample_type>::close()
+{
+  std::lock_guard<std::mutex> lock(_source_lock);
+  closeSource();
+}
+
+template <typename sample_type>
+void AudioInI2ST<sample_type>::closeSource()
+{
+  if (_file != nullptr)
+  {
+    fclose(_file);
+    _file = nullptr;
+  }
+  _source = SOURCE_SILENCE;
+  _generator = nullptr;
+  _end = false;
+}
+
+template <typename sample_type>
+void AudioInI2ST<sample_type>::setRealtime(bool realtime)
+{
+  std::lock_guard<std::mutex> lock(_source_lock);
+  _realtime = realtime;
+  _clock_start = std::chrono::steady_clock::now();
+  _clock_samples = 0;
+}
+
+template <typename sample_type>
+bool AudioInI2ST<sample_type>::isEnd()
+{
+  return _end;
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::getSourceSampleRate()
+{
+  std::lock_guard<std::mutex> lock(_source_lock);
+  return _source_rate;
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::produce(int32_t _samples[], int length)
+{
+  int step = channels();
+  if (_source == SOURCE_GENERATOR)
+  {
+    for (int i = 0; i + step <= length; i += step)
+    {
+      float v = _generator(_index++, _sample_rate);
+      v = v > 1 ? 1 : v < -1 ? -1 : v;
+      _samples[i] = (int32_t)(v * 2147483647.0); // in double, 2147483647.0f rounds up to 2^31 and overflows int32_t
+      _samples[i + step - 1] = _samples[i];
+    }
+    return length / step * step;
+  }
+  if (_source != SOURCE_FILE)
+  {
+    length = length / step * step;
+    memset(_samples, 0, sizeof(int32_t) * length);
+    return length;
+  }
+
+  uint8_t frame[32 * 4]; // up to 32 channels of 32 bits
+  uint32_t frameBytes = _bytes * _channels;
+  if (frameBytes > sizeof(frame))
+  {
+    _end = true;
+    return 0;
+  }
+  uint8_t second = _channels > 1 ? 1 : 0; // right channel in stereo, mono plays on both
+  int count = 0;
+  while (count + step <= length && !_end)
+  {
+    if ((_data_size > 0 && _data_read + frameBytes > _data_size) || fread(frame, 1, frameBytes, _file) != frameBytes)
+    {
+      if (!_loop || _data_read == 0)
+      {
+        _end = true;
+        break;
+      }
+      fseek(_file, _data_start, SEEK_SET);
+      _data_read = 0;
+      continue;
+    }
+    _data_read += frameBytes;
+    _samples[count++] = decode(&frame[_channel * _bytes]);
+    if (step == 2)
+    {
+      _samples[count++] = decode(&frame[second * _bytes]);
+    }
+    _index++;
+  }
+  return count;
+}
+
+template <typename sample_type>
+int32_t AudioInI2ST<sample_type>::decode(const uint8_t *bytes)
+{
+  if (_format == 3)
+  {
+    float f;
+    memcpy(&f, bytes, sizeof(f)); // little endian host
+    f = f > 1 ? 1 : f < -1 ? -1 : f;
+    return (int32_t)(f * 2147483647.0);
+  }
+  if (_bytes == 1)
+  {
+    return (int32_t)((uint32_t)(bytes[0] ^ 0x80) << 24); // 8 bit WAV is unsigned
+  }
+  uint32_t u = 0;
+  for (uint8_t i = 0; i < _bytes; i++)
+  {
+    u |= (uint32_t)bytes[i] << (8 * (4 - _bytes + i)); // left align
+  }
+  return (int32_t)u;
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::channels()
+{
+  return _channel_format == I2S_CHANNEL_FMT_RIGHT_LEFT ? 2 : 1;
+}
+
+template <typename sample_type>
+bool AudioInI2ST<sample_type>::isStereo()
+{
+  return channels() == 2;
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::produceAs(sample_type _samples[], int length)
+{
+  if (std::is_same<sample_type, int32_t>::value)
+  {
+    return produce((int32_t *)_samples, length);
+  }
+  // compact types go through a small 32 bit buffer, the same way the device packs DMA words
+  int32_t words[64];
+  int count = 0;
+  while (count < length)
+  {
+    int chunk = produce(words, min(length - count, 64));
+    for (int i = 0; i < chunk; i++)
+    {
+      _samples[count + i] = sample_type(words[i]);
+    }
+    count += chunk;
+    if (chunk == 0)
+    {
+      break;
+    }
+  }
+  return count;
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::due()
+{
+  if (!_realtime)
+  {
+    return INT32_MAX;
+  }
+  uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _clock_start).count();
+  uint64_t due = elapsed * _sample_rate / 1000000;
+  return due > _clock_samples ? (int)min(due - _clock_samples, (uint64_t)INT32_MAX) : 0;
+}
+
+template <typename sample_type>
+void AudioInI2ST<sample_type>::waitFor(int length)
+{
+  std::chrono::steady_clock::time_point until;
+  bool realtime;
+  {
+    std::lock_guard<std::mutex> lock(_source_lock);
+    realtime = _realtime;
+    until = _clock_start + std::chrono::microseconds((_clock_samples + length) * 1000000 / _sample_rate);
+    _clock_samples += length;
+  }
+  if (realtime)
+  {
+    std::this_thread::sleep_until(until); // without the lock, the source can change meanwhile
+  }
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::read(sample_type _samples[])
+{
+  return read(_samples, _sample_size);
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::read(sample_type _samples[], int length)
+{
+  if (_end || _streaming)
+  {
+    return 0; // ended, or the stream thread owns the source
+  }
+  {
+    AUDIO_PROFILE_SCOPE(AUDIO_STAGE_I2S_WAIT);
+    waitFor(length);
+  }
+  std::lock_guard<std::mutex> lock(_source_lock);
+  return produceAs(_samples, length);
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::read(sample_type left[], sample_type right[])
+{
+  return read(left, right, _sample_size);
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::read(sample_type left[], sample_type right[], int length)
+{
+  if (_end || _streaming)
+  {
+    return 0; // ended, or the stream thread owns the source
+  }
+  {
+    AUDIO_PROFILE_SCOPE(AUDIO_STAGE_I2S_WAIT);
+    waitFor(length);
+  }
+  // pairs are split in small chunks, the same way the device copies them out of DMA
+  std::lock_guard<std::mutex> lock(_source_lock);
+  sample_type pairs[64];
+  int count = 0;
+  while (count < length)
+  {
+    int pairs_read = produceAs(pairs, 2 * min(length - count, 32)) / 2;
+    for (int i = 0; i < pairs_read; i++)
+    {
+      left[count + i] = pairs[2 * i];
+      right[count + i] = pairs[2 * i + 1];
+    }
+    count += pairs_read;
+    if (pairs_read == 0)
+    {
+      break;
+    }
+  }
+  return count;
+}
+
+template <typename sample_type>
+bool AudioInI2ST<sample_type>::beginStream(int ring_size, int core)
+{
+  if (_dma_chunk != nullptr)
+  {
+    return true; // already streaming
+  }
+  if (ring_size <= 0)
+  {
+    ring_size = _dma_buf_count * _dma_buf_len;
+  }
+  _ring.begin(ring_size * channels()); // stereo rings hold left/right pairs
+  _dma_chunk = new sample_type[_dma_buf_len * channels()];
+  if (core < 0)
+  {
+    return true; // polled from available()/readAvailable()
+  }
+  _streaming = true;
+  _stream_thread = new std::thread(&AudioInI2ST::streamThread, this);
+  return true;
+}
+
+template <typename sample_type>
+void AudioInI2ST<sample_type>::streamThread()
+{
+  while (_streaming)
+  {
+    pump(true);
+  }
+}
+
+template <typename sample_type>
+void AudioInI2ST<sample_type>::pump(bool wait)
+{
+  // realtime: every due DMA buffer is written, a full ring drops it like the device does.
+  // offline: buffers are only made when they fit so nothing is ever lost.
+  uint32_t buffer_length = _dma_buf_len * channels();
+  for (;;)
+  {
+    std::unique_lock<std::mutex> lock(_source_lock); // never held while sleeping
+    if (_end)
+    {
+      lock.unlock();
+      if (wait)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      return;
+    }
+    if (_realtime ? due() < _dma_buf_len : _ring.capacity() - _ring.available() < buffer_length)
+    {
+      int pause = _realtime ? 1000000 * _dma_buf_len / _sample_rate / 4 : 1000;
+      lock.unlock();
+      if (!wait)
+      {
+        return;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(pause));
+      continue;
+    }
+    _clock_samples += _dma_buf_len;
+    int samples_read = produceAs(_dma_chunk, buffer_length);
+    lock.unlock();
+    if (samples_read > 0 && _ring.write(_dma_chunk, samples_read) == 0)
+    {
+      AUDIO_PROFILE_DROPS(1); // ring full
+    }
+    if (wait)
+    {
+      return; // the thread comes back for the next buffer
+    }
+  }
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::available()
+{
+  if (_dma_chunk == nullptr)
+  {
+    return 0;
+  }
+  if (!_streaming)
+  {
+    pump(false);
+  }
+  return _ring.available() / channels();
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::readAvailable(sample_type _samples[], int length)
+{
+  if (_dma_chunk == nullptr)
+  {
+    return 0;
+  }
+  if (!_streaming)
+  {
+    pump(false);
+  }
+  return _ring.read(_samples, length);
+}
+
+template <typename sample_type>
+int AudioInI2ST<sample_type>::readAvailable(sample_type left[], sample_type right[], int length)
+{
+  if (_dma_chunk == nullptr)
+  {
+    return 0;
+  }
+  if (!_streaming)
+  {
+    pump(false);
+  }
+  // whole "DMA buffers" go into the ring so it always holds complete pairs
+  sample_type pairs[64];
+  int count = 0;
+  while (count < length)
+  {
+    int pairs_read = _ring.read(pairs, 2 * min(length - count, 32)) / 2;
+    for (int i = 0; i < pairs_read; i++)
+    {
+      left[count + i] = pairs[2 * i];
+      right[count + i] = pairs[2 * i + 1];
+    }
+    count += pairs_read;
+    if (pairs_read == 0)
+    {
+      break;
+    }
+  }
+  return count;
+}
+
+template <typename sample_type>
+uint32_t AudioInI2ST<sample_type>::getOverruns()
+{
+  return _ring.getOverruns();
+}
+
+typedef AudioInI2ST<> AudioInI2S;
+
+#endif // AudioInI2SHost_H
@@ -0,0 +1,286 @@
+#ifndef AudioPipeline_H
+#define AudioPipeline_H
+
+#include "AudioPlatform.h"
+#include "AudioInI2S.h"
+#include "AudioFrequencyAnalysis.h"
+#include "TripleBuffer.h"
+
+/*
+    AudioPipeline.h
+    By Shea Ivey
+
+    https://github.com/sheaivey/ESP32-AudioInI2S
+
+    Runs I2S capture and AudioFrequencyAnalysis in a task pinned to one core and
+    publishes every finished frame through a TripleBuffer so rendering on the
+    other core never waits on the microphone or the FFT. Frames carry the
+    FrequencyRanges of both channels of a stereo analyzer, sized like the analyzer.
+*/
+
+struct FrequencyRangeFrame
+{
+  float value = 0;
+  float peak = 0;
+  float min = 0;
+  float max = 1;
+  float scaleMax = 1; // _max of the range when in isolation otherwise the analysis _max
+  uint16_t maxFrequency = 0;
+};
+
+// One channel of a published frame, RangeSize as in AudioFrequencyAnalysisT<>.
+template <uint8_t RangeSize = BAND_SIZE + BAND_SIZE_PADDING>
+struct AudioChannelFrameT
+{
+  float min = 0;
+  float max = 0;
+  float samplesMin = 0;
+  float samplesMax = 1;
+  uint8_t rangesLength = 0;
+  FrequencyRangeFrame ranges[RangeSize]; // in addFrequencyRange() order
+
+  float getValue(uint8_t index) const;                       // returns the raw value
+  float getValue(uint8_t index, float min, float max) const; // returns the calculated value
+  float getPeak(uint8_t index) const;                        // returns the raw peak
+  float getPeak(uint8_t index, float min, float max) const;  // returns the calculated peak
+  uint16_t getMaxFrequency(uint8_t index) const;             // gets the max frequency in Hz within the range
+
+  float mapAndClip(uint8_t index, float x, float out_min, float out_max) const;
+};
+
+// Left (or mono) channel in the frame itself, the right one after AudioFrequencyAnalysisBase::setStereo().
+template <uint8_t RangeSize = BAND_SIZE + BAND_SIZE_PADDING>
+struct AudioFrameT : AudioChannelFrameT<RangeSize>
+{
+  uint32_t frame = 0;                  // increments for every published frame
+  AudioChannelFrameT<RangeSize> right; // right channel, rangesLength 0 unless the analyzer is stereo
+};
+
+// Publishes AudioFrequencyAnalysis frames only, AudioAnalysis bands/peaks/VU are not carried.
+// Add a FrequencyRange(0, 20000) with _inIsolation = true for a VU meter.
+template <uint8_t RangeSize = BAND_SIZE + BAND_SIZE_PADDING>
+class AudioPipelineT
+{
+public:
+  template <uint16_t SampleSize, uint8_t AnalyzerRangeSize>
+  AudioPipelineT(AudioInI2S *mic, AudioFrequencyAnalysisT<SampleSize, AnalyzerRangeSize> *audioInfo); // any AudioFrequencyAnalysisT<> size with up to RangeSize ranges
+  ~AudioPipelineT();
+
+  bool begin(int sampleSize, int sampleRate, int hopSize = 0, int core = 0); // starts the capture/analysis task on core. core -1 = no task, call process() yourself
+                                                                              // false if the right analyzer holds more than RangeSize ranges or the mic is not stereo
+  void process();  // reads one hop, analyses it and publishes the frame when ready
+
+  bool available();         // a newer frame was published since the last read()
+  const AudioFrameT<RangeSize> &read(); // latest finished frame, never blocks
+
+private:
+  static void pipelineTask(void *param);
+  void publish();
+  void publishChannel(AudioChannelFrameT<RangeSize> &channel, AudioFrequencyAnalysisBase *audioInfo);
+
+  AudioInI2S *_mic = nullptr;
+  AudioFrequencyAnalysisBase *_audioInfo = nullptr;
+  int _sampleSize = SAMPLE_SIZE;
+  int _sampleRate = SAMPLE_RATE;
+  int _hopSize = SAMPLE_SIZE;
+  int32_t _hop[SAMPLE_SIZE]; // larger analyzers take several reads per hop
+  int32_t *_hopRight = nullptr; // right channel of the hop, only allocated for stereo analyzers
+  uint32_t _frame = 0;
+  TaskHandle_t _task = nullptr;
+
+  TripleBuffer<AudioFrameT<RangeSize>> _frames;
+};
+
+typedef AudioChannelFrameT<> AudioChannelFrame;
+typedef AudioFrameT<> AudioFrame;
+typedef AudioPipelineT<> AudioPipeline;
+
+template <uint8_t RangeSize>
+template <uint16_t SampleSize, uint8_t AnalyzerRangeSize>
+AudioPipelineT<RangeSize>::AudioPipelineT(AudioInI2S *mic, AudioFrequencyAnalysisT<SampleSize, AnalyzerRangeSize> *audioInfo)
+{
+  static_assert(AnalyzerRangeSize <= RangeSize, "the frames hold fewer ranges than the analyzer, use AudioPipelineT<RangeSize> of the analyzer");
+  _mic = mic;
+  _audioInfo = audioInfo;
+}
+
+template <uint8_t RangeSize>
+AudioPipelineT<RangeSize>::~AudioPipelineT()
+{
+  delete[] _hopRight;
+}
+
+template <uint8_t RangeSize>
+bool AudioPipelineT<RangeSize>::begin(int sampleSize, int sampleRate, int hopSize, int core)
+{
+  AudioFrequencyAnalysisBase *rightInfo = _audioInfo->getRightChannel();
+  if (rightInfo != nullptr)
+  {
+    if (rightInfo->getRangeCapacity() > RangeSize || !_mic->isStereo())
+    {
+      return false;
+    }
+    if (_hopRight == nullptr)
+    {
+      _hopRight = new int32_t[SAMPLE_SIZE];
+    }
+  }
+  _sampleSize = sampleSize;
+  _sampleRate = sampleRate;
+  _hopSize = hopSize > 0 && hopSize < sampleSize ? hopSize : sampleSize;
+  _audioInfo->setHopSize(_hopSize);
+  if (_hopSize > SAMPLE_SIZE)
+  {
+    _hopSize = SAMPLE_SIZE; // read size, stream() still waits for the full hop
+  }
+  if (core < 0)
+  {
+    return true;
+  }
+  return xTaskCreatePinnedToCore(pipelineTask, "AudioPipeline", 4096, this, 1, &_task, core) == pdPASS;
+}
+
+template <uint8_t RangeSize>
+void AudioPipelineT<RangeSize>::pipelineTask(void *param)
+{
+  AudioPipelineT *pipeline = (AudioPipelineT *)param;
+  for (;;)
+  {
+    pipeline->process(); // blocks on I2S, which frees the core between hops
+  }
+}
+
+template <uint8_t RangeSize>
+void AudioPipelineT<RangeSize>::process()
+{
+  // follow the governor of the analyzer, see AudioFrequencyAnalysisBase::setFrameBudget()
+  int sampleSize = _audioInfo->getGovernedSampleSize();
+  int sampleRate = _audioInfo->getGovernedSampleRate();
+  if (sampleRate != _sampleRate && _mic->setSampleRate(sampleRate))
+  {
+    _sampleRate = sampleRate;
+  }
+  if (sampleSize != _sampleSize)
+  {
+    int hopSize = _audioInfo->getHopSize() * sampleSize / _sampleSize; // same overlap
+    _audioInfo->setHopSize(hopSize);
+    _hopSize = min(hopSize, SAMPLE_SIZE);
+    _sampleSize = sampleSize;
+  }
+  if (_hopRight != nullptr)
+  {
+    int samplesRead = _mic->read(_hop, _hopRight, _hopSize);
+    _audioInfo->setInputLatency(_mic->getLatency());
+    if (samplesRead > 0 && _audioInfo->stream(_hop, _hopRight, samplesRead, _sampleSize, _sampleRate))
+    {
+      publish();
+    }
+    return;
+  }
+  int samplesRead = _mic->read(_hop, _hopSize);
+  _audioInfo->setInputLatency(_mic->getLatency());
+  if (samplesRead > 0 && _audioInfo->stream(_hop, samplesRead, _sampleSize, _sampleRate))
+  {
+    publish();
+  }
+}
+
+template <uint8_t RangeSize>
+void AudioPipelineT<RangeSize>::publish()
+{
+  AudioFrameT<RangeSize> &frame = _frames.writeBuffer();
+  frame.frame = ++_frame;
+  publishChannel(frame, _audioInfo);
+  if (_hopRight != nullptr)
+  {
+    publishChannel(frame.right, _audioInfo->getRightChannel());
+  }
+  _frames.publish();
+}
+
+template <uint8_t RangeSize>
+void AudioPipelineT<RangeSize>::publishChannel(AudioChannelFrameT<RangeSize> &channel, AudioFrequencyAnalysisBase *audioInfo)
+{
+  channel.min = audioInfo->_min;
+  channel.max = audioInfo->_max;
+  channel.samplesMin = audioInfo->getSampleMin();
+  channel.samplesMax = audioInfo->getSampleMax();
+  channel.rangesLength = audioInfo->_frequencyRangesLength; // never more than RangeSize, checked by the constructor and begin()
+  for (int i = 0; i < channel.rangesLength; i++)
+  {
+    FrequencyRange *range = audioInfo->_frequencyRanges[i];
+    FrequencyRangeFrame &out = channel.ranges[i];
+    out.value = range->_value;
+    out.peak = range->_peak;
+    out.min = range->_min;
+    out.max = range->_max;
+    out.scaleMax = range->_inIsolation ? range->_max : audioInfo->_max;
+    out.maxFrequency = range->getMaxFrequency();
+  }
+}
+
+template <uint8_t RangeSize>
+bool AudioPipelineT<RangeSize>::available()
+{
+  return _frames.update();
+}
+
+template <uint8_t RangeSize>
+const AudioFrameT<RangeSize> &AudioPipelineT<RangeSize>::read()
+{
+  _frames.update();
+  return _frames.readBuffer();
+}
+
+template <uint8_t RangeSize>
+float AudioChannelFrameT<RangeSize>::getValue(uint8_t index) const
+{
+  return index < rangesLength ? ranges[index].value : 0;
+}
+
+template <uint8_t RangeSize>
+float AudioChannelFrameT<RangeSize>::getValue(uint8_t index, float min, float max) const
+{
+  return index < rangesLength ? mapAndClip(index, ranges[index].value, min, max) : 0;
+}
+
+template <uint8_t RangeSize>
+float AudioChannelFrameT<RangeSize>::getPeak(uint8_t index) const
+{
+  return index < rangesLength ? ranges[index].peak : 0;
+}
+
+template <uint8_t RangeSize>
+float AudioChannelFrameT<RangeSize>::getPeak(uint8_t index, float min, float max) const
+{
+  return index < rangesLength ? mapAndClip(index, ranges[index].peak, min, max) : 0;
+}
+
+template <uint8_t RangeSize>
+uint16_t AudioChannelFrameT<RangeSize>::getMaxFrequency(uint8_t index) const
+{
+  return index < rangesLength ? ranges[index].maxFrequency : 0;
+}
+
+template <uint8_t RangeSize>
+float AudioChannelFrameT<RangeSize>::mapAndClip(uint8_t index, float x, float out_min, float out_max) const
+{
+  // same mapping as FrequencyRange::mapAndClip()
+  const FrequencyRangeFrame &range = ranges[index];
+  float in_max = range.scaleMax == 0 ? 1 : range.scaleMax;
+  if (x > range.max)
+  {
+    x = range.max;
+  }
+  else if (x > in_max)
+  {
+    x = in_max;
+  }
+  else if (x < 0)
+  {
+    x = 0;
+  }
+  return x * (out_max - out_min) / in_max + out_min;
+}
+
+#endif // AudioPipeline_H
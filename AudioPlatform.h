@@ -0,0 +1,92 @@
+#ifndef AudioPlatform_h
+#define AudioPlatform_h
+
+/*
+    AudioPlatform.h
+    By Shea Ivey
+
+    https://github.com/sheaivey/ESP32-AudioInI2S
+
+    The few Arduino and FreeRTOS pieces the library uses. On the ESP32 this is just Arduino.h,
+    anywhere else (Linux, macOS) it is a small shim so the analysis headers build natively
+    with plain g++ and AudioInI2S reads from WAV/raw files or a generator (AudioInI2SHost.h).
+*/
+
+#ifdef ARDUINO
+
+#include "Arduino.h"
+
+#else
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using std::abs;
+using std::max;
+using std::min;
+
+typedef bool boolean;
+
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+#ifndef TWO_PI
+#define TWO_PI 6.283185307179586476925286766559
+#endif
+
+inline unsigned long micros()
+{
+  static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+inline unsigned long millis()
+{
+  return micros() / 1000;
+}
+
+inline void delay(unsigned long ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+/* FreeRTOS */
+typedef void *TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+#define portMAX_DELAY 0xffffffff
+#define portTICK_PERIOD_MS 1
+#define pdPASS 1
+#define pdFAIL 0
+#define configMAX_PRIORITIES 25
+
+// tasks become detached threads, the priority and core are ignored
+inline BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char * /* name */, uint32_t /* stackDepth */, void *param, int /* priority */, TaskHandle_t *handle, int /* core */)
+{
+  std::thread thread(task, param);
+  if (handle != nullptr)
+  {
+    *handle = (TaskHandle_t)1; // only ever compared against nullptr
+  }
+  thread.detach();
+  return pdPASS;
+}
+
+inline void vTaskDelay(TickType_t ticks)
+{
+  delay(ticks * portTICK_PERIOD_MS);
+}
+
+#endif // ARDUINO
+
+#endif // AudioPlatform_h
@@ -0,0 +1,209 @@
+#ifndef AudioProfiler_h
+#define AudioProfiler_h
+
+#include "AudioPlatform.h"
+
+/*
+    AudioProfiler.h
+    By Shea Ivey
+
+    https://github.com/sheaivey/ESP32-AudioInI2S
+
+    Opt-in timing of the hot path. Define AUDIO_PROFILE before including the library headers
+    and every stage below records how long it took into a window of the last
+    AUDIO_PROFILE_WINDOW calls, read it back with audioProfiler.getStats(stage).
+    Without AUDIO_PROFILE the AUDIO_PROFILE_* macros are empty and nothing is compiled in.
+
+    Times are in clock ticks: CPU cycles on the ESP32, nanoseconds anywhere else.
+    setClock() plugs in any other counter, toMicroseconds() converts ticks for printing.
+    Stages are written by the task running them and read from anywhere, a stats read racing
+    a write can be off by one call which is fine for diagnostics.
+
+      AUDIO_PROFILE_SCOPE(AUDIO_STAGE_RENDER); // times the rest of the enclosing block
+*/
+
+enum audio_stage
+{
+  AUDIO_STAGE_I2S_WAIT = 0,    // blocked in AudioInI2S::read() waiting on DMA
+  AUDIO_STAGE_ANALYSIS,        // AudioFrequencyAnalysis::loop() or a stream() frame
+  AUDIO_STAGE_PREP,            // copy and min/max scan of the samples
+  AUDIO_STAGE_FFT,             // dcRemoval, windowing, FFT and magnitudes
+  AUDIO_STAGE_BINS,            // bin table pass of every range
+  AUDIO_STAGE_FEATURES,        // spectral features of a frame, see AudioFrequencyAnalysis::setFeatures()
+  AUDIO_STAGE_RANGE_LOOP,      // one FrequencyRange::loop()
+  AUDIO_STAGE_COMPUTE_FFT,     // AudioAnalysis::computeFFT()
+  AUDIO_STAGE_FREQUENCIES,     // AudioAnalysis::computeFrequencies()
+  AUDIO_STAGE_BEAT,            // BeatDetector::process()
+  AUDIO_STAGE_RENDER,          // free for the sketch, drawing etc.
+  AUDIO_STAGE_USER,            // free for the sketch
+  AUDIO_STAGE_COUNT
+};
+
+#ifdef AUDIO_PROFILE
+
+#ifndef AUDIO_PROFILE_WINDOW
+#define AUDIO_PROFILE_WINDOW 128 // calls per stage the stats are calculated over
+#endif
+
+#include <algorithm>
+
+struct AudioStageStats
+{
+  uint32_t calls = 0; // since the last reset()
+  uint16_t count = 0; // calls in the window
+  uint32_t min = 0;   // ticks
+  uint32_t avg = 0;
+  uint32_t max = 0;
+  uint32_t p99 = 0;
+};
+
+class AudioProfiler
+{
+public:
+  AudioProfiler();
+
+  void setClock(uint32_t (*clock)(), float ticksPerMicrosecond); // any free running counter, wraps are fine
+  uint32_t now();                                                 // current clock ticks
+  float toMicroseconds(uint32_t ticks);
+
+  void record(audio_stage stage, uint32_t ticks); // adds one call of stage
+  void addDrops(uint32_t buffers);                // I2S buffers lost because the reader fell behind
+  AudioStageStats getStats(audio_stage stage);    // min/avg/max/p99 over the window
+  uint32_t getDrops();                            // dropped I2S buffers since the last reset()
+  void reset();
+
+private:
+  static uint32_t defaultClock();
+
+  uint32_t (*_clock)() = nullptr;
+  float _ticksPerMicrosecond = 1;
+  uint32_t _window[AUDIO_STAGE_COUNT][AUDIO_PROFILE_WINDOW];
+  uint32_t _calls[AUDIO_STAGE_COUNT];
+  uint32_t _drops = 0;
+};
+
+// times from construction to the end of the enclosing block
+class AudioProfileScope
+{
+public:
+  AudioProfileScope(audio_stage stage);
+  ~AudioProfileScope();
+
+private:
+  audio_stage _stage;
+  uint32_t _start;
+};
+
+AudioProfiler audioProfiler;
+
+#define AUDIO_PROFILE_JOIN2(a, b) a##b
+#define AUDIO_PROFILE_JOIN(a, b) AUDIO_PROFILE_JOIN2(a, b)
+#define AUDIO_PROFILE_SCOPE(stage) AudioProfileScope AUDIO_PROFILE_JOIN(_audioProfileScope, __LINE__)(stage)
+#define AUDIO_PROFILE_DROPS(buffers) audioProfiler.addDrops(buffers)
+
+AudioProfiler::AudioProfiler()
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  setClock(defaultClock, getCpuFrequencyMhz());
+#else
+  setClock(defaultClock, 1000);
+#endif
+  reset();
+}
+
+uint32_t AudioProfiler::defaultClock()
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  return ESP.getCycleCount();
+#elif defined(ARDUINO)
+  return micros();
+#else
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void AudioProfiler::setClock(uint32_t (*clock)(), float ticksPerMicrosecond)
+{
+  _clock = clock;
+  _ticksPerMicrosecond = ticksPerMicrosecond > 0 ? ticksPerMicrosecond : 1;
+}
+
+uint32_t AudioProfiler::now()
+{
+  return _clock();
+}
+
+float AudioProfiler::toMicroseconds(uint32_t ticks)
+{
+  return ticks / _ticksPerMicrosecond;
+}
+
+void AudioProfiler::record(audio_stage stage, uint32_t ticks)
+{
+  uint32_t calls = _calls[stage];
+  _window[stage][calls % AUDIO_PROFILE_WINDOW] = ticks;
+  _calls[stage] = calls + 1;
+}
+
+void AudioProfiler::addDrops(uint32_t buffers)
+{
+  _drops += buffers;
+}
+
+AudioStageStats AudioProfiler::getStats(audio_stage stage)
+{
+  AudioStageStats stats;
+  stats.calls = _calls[stage];
+  stats.count = min(stats.calls, (uint32_t)AUDIO_PROFILE_WINDOW);
+  if (stats.count == 0)
+  {
+    return stats;
+  }
+  uint32_t sorted[AUDIO_PROFILE_WINDOW];
+  uint64_t sum = 0;
+  for (uint16_t i = 0; i < stats.count; i++)
+  {
+    sorted[i] = _window[stage][i];
+    sum += sorted[i];
+  }
+  std::sort(sorted, sorted + stats.count);
+  stats.min = sorted[0];
+  stats.max = sorted[stats.count - 1];
+  stats.avg = sum / stats.count;
+  stats.p99 = sorted[(stats.count * 99 + 99) / 100 - 1]; // nearest rank
+  return stats;
+}
+
+uint32_t AudioProfiler::getDrops()
+{
+  return _drops;
+}
+
+void AudioProfiler::reset()
+{
+  for (int s = 0; s < AUDIO_STAGE_COUNT; s++)
+  {
+    _calls[s] = 0;
+  }
+  _drops = 0;
+}
+
+AudioProfileScope::AudioProfileScope(audio_stage stage)
+{
+  _stage = stage;
+  _start = audioProfiler.now();
+}
+
+AudioProfileScope::~AudioProfileScope()
+{
+  audioProfiler.record(_stage, audioProfiler.now() - _start);
+}
+
+#else
+
+#define AUDIO_PROFILE_SCOPE(stage)
+#define AUDIO_PROFILE_DROPS(buffers)
+
+#endif // AUDIO_PROFILE
+
+#endif // AudioProfiler_h
@@ -0,0 +1,47 @@
+#ifndef AudioSample_h
+#define AudioSample_h
+
+#include <stdint.h>
+
+/*
+    AudioSample.h
+    By Shea Ivey
+
+    https://github.com/sheaivey/ESP32-AudioInI2S
+
+    Compact sample types for AudioInI2ST<> and the analyzers. They store fewer bits but read
+    back left aligned in 32 bits, the way the INMP441 delivers int32_t samples, so the same
+    sound gives the same levels, noise floors and auto levels whatever type it was captured in.
+      int32_t    - 32 bit words, 24 bits of data from an INMP441. The default.
+      sample24_t - packed 24 bit, 3 bytes per sample.
+      sample16_t - 16 bit, 2 bytes per sample. Half the DMA and ring memory.
+    Plain int16_t samples still read as they are, at 16 bit scale.
+*/
+
+struct sample16_t
+{
+  int16_t value;
+
+  sample16_t() = default;
+  explicit sample16_t(int32_t left) : value(left >> 16) {} // keeps the top 16 bits
+  operator int32_t() const { return (int32_t)((uint32_t)(uint16_t)value << 16); }
+};
+
+struct sample24_t
+{
+  uint8_t bytes[3]; // little endian
+
+  sample24_t() = default;
+  explicit sample24_t(int32_t left) // keeps the top 24 bits
+  {
+    bytes[0] = left >> 8;
+    bytes[1] = left >> 16;
+    bytes[2] = left >> 24;
+  }
+  operator int32_t() const { return (int32_t)((uint32_t)bytes[0] << 8 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 24); } // top byte carries the sign
+};
+
+static_assert(sizeof(sample16_t) == 2, "sample16_t must be 2 bytes");
+static_assert(sizeof(sample24_t) == 3, "sample24_t must be packed into 3 bytes");
+
+#endif // AudioSample_h
@@ -0,0 +1,488 @@
+#ifndef BeatDetector_h
+#define BeatDetector_h
+
+#include "AudioFrequencyAnalysis.h"
+
+/*
+    BeatDetector.h
+    By Shea Ivey
+
+    https://github.com/sheaivey/ESP32-AudioInI2S
+
+    Onsets and beats from the FrequencyRanges an AudioFrequencyAnalysis already calculates.
+    Time moves on by the samples every frame really stepped, tempo frames are cut from that
+    time at a fixed length so uneven stream() reads do not disturb the tempo search.
+    Onsets: spectral flux, the rise of every range in log units, above an adaptive threshold
+    (running mean plus a multiple of the running mean deviation) with a refractory time.
+    Tempo: the flux above its mean is autocorrelated with exponential forgetting, one
+    multiply add per lag and frame, the best lag between the min and max tempo wins after a
+    log tempo prior and a double period check. Phase runs freely at that tempo and is pulled
+    towards the onsets close to a predicted beat, isBeat() fires when it wraps.
+    All buffers belong to BeatDetectorT<>, nothing is allocated.
+*/
+
+#ifndef BEAT_TEMPO_RATE
+#define BEAT_TEMPO_RATE 100 // most tempo frames per second, faster frame rates are merged
+#endif
+
+class BeatDetectorBase
+{
+public:
+  bool process(AudioFrequencyAnalysisBase *audioInfo); // call after every new frame of audioInfo (loop(), or stream() returned true). returns isBeat()
+  void reset();                                        // forgets onsets, tempo and phase
+
+  void setTempoRange(float minBpm = 60, float maxBpm = 200); // tempos the tracker can lock to
+  void setPreferredTempo(float bpm = 120);                   // center of the tempo prior, breaks ties between half and double tempo
+  void setSensitivity(float sensitivity = 2, float minimumFlux = 0.05); // onset threshold in mean deviations above the mean flux, minimumFlux stops silence from triggering
+  void setLookAhead(float seconds = -1); // beats and phase are predicted seconds ahead so they land on the music once shown. -1 = the analyzer latency, 0 = off
+
+  bool isOnset();           // an onset was detected on the last frame
+  bool isBeat();            // the tracked beat falls on the last frame (plus the look ahead), the onsets until a tempo is locked
+  bool isLocked();          // confidence is above _lockConfidence and onsets were heard lately, beats follow the tempo
+  float getBPM();           // tempo in beats per minute, 0 until enough onsets were heard
+  float getBeatPhase();     // 0 on the beat rising to 1 just before the next one, the look ahead included
+  float getBeatPeriod();    // seconds between beats, 0 until enough onsets were heard
+  float getConfidence();    // 0 - 1 how periodic the onsets are at the tempo
+  float getOnsetStrength(); // spectral flux of the last frame
+  float getThreshold();     // flux the last frame had to reach to be an onset
+
+  /* Library Settings */
+  float _sensitivity = 2;
+  float _minimumFlux = 0.05;
+  float _compression = 100;       // ranges are log(1 + compression * value / level), far below the loudest range rises hardly count
+  float _levelSeconds = 10;       // time the loudest range level takes to fall to a third
+  float _refractorySeconds = 0.1; // shortest time between onsets
+  float _thresholdSeconds = 1;    // time constant of the flux mean and deviation
+  float _tempoSeconds = 8;        // time constant of the autocorrelation, how fast a new tempo takes over
+  float _lockConfidence = 0.4;    // confidence needed before beats follow the tempo
+  float _holdBeats = 4;           // beats without an onset before the tempo is no longer followed
+  float _phaseCorrection = 0.1;   // part of the phase error corrected every tempo frame while locked
+  float _lookAhead = 0;           // seconds, -1 = the analyzer latency
+
+  /* Onset Variables */
+  float *_previous;          // log value of every range on the last frame
+  uint8_t _rangeCapacity;
+  uint8_t _rangesLength = 0; // ranges seen on the last frame, a new range starts without flux
+  float _level = 0;      // loudest range value, falling slowly
+  float _frameLevel = 0; // loudest range value of the last frame
+  float _flux = 0;
+  float _fluxMean = 0;
+  float _fluxDeviation = 0;
+  float _threshold = 0;
+  float _sinceOnset = 0; // seconds
+  float _time = 0;       // seconds since reset()
+  bool _onset = false;
+  bool _beat = false;
+
+  /* Tempo Variables */
+  float *_history;        // tempo frames of flux above its mean, ring
+  float *_acf;            // autocorrelation of _history for lags 0 .. 2 * _maxLag + 1
+  float *_prior;          // tempo prior of lags _minLag .. _maxLag
+  uint16_t _lagCapacity;
+  uint16_t _historyIndex = 0;
+  uint16_t _minLag = 0;
+  uint16_t _maxLag = 0;
+  float _minBpm = 60;
+  float _maxBpm = 200;
+  float _preferredBpm = 120;
+  int _frameStep = 0;         // nominal samples per frame (the hop) the tables were built for
+  int _sampleRate = 0;
+  float _frameSeconds = 0;    // seconds the last frame moved on by
+  float _tempoElapsed = 0;    // seconds towards the next tempo frame, the overshoot of the last one included
+  float _tempoOnset = 0;      // largest flux above the mean of the merged frames
+  float _tempoFrameSeconds = 0;
+  float _acfDecay = 1;
+  float _lag = 0;             // beat period in tempo frames, fractional. 0 = unknown
+  float _period = 0;          // beat period in seconds
+  float _confidence = 0;
+  float _phase = 0;        // phase of the last frame
+  float _beatPhase = 0;    // _phase plus the look ahead
+  float _lookAheadSeconds = 0;
+  float _sinceBeat = 0;    // seconds
+
+  void setFormat(int frameStep, int sampleRate); // tempo frame length, lag range and prior for a nominal frame step
+  uint8_t computeFlux(AudioFrequencyAnalysisBase *audioInfo, uint8_t offset, float &total); // adds the rise of audioInfo's ranges, returns the next offset
+  void updateTempo(float onset); // one tempo frame into the autocorrelation
+  void estimateTempo();          // best lag of the autocorrelation
+  float periodicity(int lag);    // autocorrelation peak at a lag
+  float scoreLag(int lag);       // prior weighted periodicity of a lag
+  void estimatePhase();          // steers the phase towards the strongest onsets at the beat period
+  void updatePhase();            // advances the phase one frame, fires the beats
+
+protected:
+  BeatDetectorBase(float *previous, float *history, float *acf, float *prior, uint8_t rangeCapacity, uint16_t lagCapacity);
+};
+
+// Detector with room for RangeSize frequency ranges (both channels when stereo) and
+// LagSize tempo frames of history, 2x the longest beat period.
+//   BeatDetectorT<16, 128> beat; // up to 16 ranges, 60 BPM at 64 tempo frames per second
+template <uint8_t RangeSize = BAND_SIZE + BAND_SIZE_PADDING, uint16_t LagSize = 256>
+class BeatDetectorT : public BeatDetectorBase
+{
+  static_assert(LagSize >= 16, "LagSize must hold at least 16 tempo frames");
+
+public:
+  BeatDetectorT()
+      : BeatDetectorBase(_previousBuffer, _historyBuffer, _acfBuffer, _priorBuffer, RangeSize, LagSize)
+  {
+  }
+
+private:
+  float _previousBuffer[RangeSize] = {};
+  float _historyBuffer[LagSize] = {};
+  float _acfBuffer[LagSize] = {};
+  float _priorBuffer[LagSize / 2] = {};
+};
+
+typedef BeatDetectorT<> BeatDetector;
+
+BeatDetectorBase::BeatDetectorBase(float *previous, float *history, float *acf, float *prior, uint8_t rangeCapacity, uint16_t lagCapacity)
+{
+  _previous = previous;
+  _history = history;
+  _acf = acf;
+  _prior = prior;
+  _rangeCapacity = rangeCapacity;
+  _lagCapacity = lagCapacity;
+}
+
+bool BeatDetectorBase::process(AudioFrequencyAnalysisBase *audioInfo)
+{
+  AUDIO_PROFILE_SCOPE(AUDIO_STAGE_BEAT);
+  // the tables follow the hop, the frame step of stream() varies with the reads
+  if (audioInfo->getNominalFrameStep() != _frameStep || audioInfo->getSampleRate() != _sampleRate)
+  {
+    setFormat(audioInfo->getNominalFrameStep(), audioInfo->getSampleRate());
+  }
+  _frameSeconds = _sampleRate > 0 ? (float)audioInfo->getFrameStep() / _sampleRate : 0;
+  _time += _frameSeconds;
+  _sinceOnset += _frameSeconds;
+  _lookAheadSeconds = _lookAhead < 0 ? audioInfo->getLatency() : _lookAhead;
+
+  float total = 0;
+  _frameLevel = 0;
+  uint8_t rangesLength = computeFlux(audioInfo, 0, total);
+  if (audioInfo->_rightInfo != nullptr)
+  {
+    rangesLength = computeFlux(audioInfo->_rightInfo, rangesLength, total);
+  }
+  _flux = rangesLength > 0 ? total / rangesLength : 0;
+  _rangesLength = rangesLength;
+  _level = max(_frameLevel, _level * expf(-_frameSeconds / _levelSeconds));
+
+  // threshold from the frames before this one, so an onset does not raise its own bar
+  _threshold = _fluxMean + _sensitivity * _fluxDeviation + _minimumFlux;
+  _onset = _flux > _threshold && _sinceOnset >= _refractorySeconds && _time > _thresholdSeconds * 0.25;
+  if (_onset)
+  {
+    _sinceOnset = 0;
+  }
+  float onset = max(0.0f, _flux - _fluxMean);
+  float alpha = _frameSeconds / (_thresholdSeconds + _frameSeconds);
+  _fluxDeviation += alpha * (fabsf(_flux - _fluxMean) - _fluxDeviation);
+  _fluxMean += alpha * (_flux - _fluxMean);
+
+  updatePhase();
+
+  // tempo frames run at no more than BEAT_TEMPO_RATE, keeping the strongest flux of the merged frames.
+  // a frame closes the tempo frame it ends nearest to, a long frame is followed by silent tempo frames
+  _tempoOnset = max(_tempoOnset, onset);
+  _tempoElapsed = min(_tempoElapsed + _frameSeconds, _lagCapacity * _tempoFrameSeconds);
+  float early = 0.5f * min(_frameSeconds, _tempoFrameSeconds);
+  while (_tempoFrameSeconds > 0 && _tempoElapsed > _tempoFrameSeconds - early)
+  {
+    updateTempo(_tempoOnset);
+    _tempoOnset = 0;
+    _tempoElapsed -= _tempoFrameSeconds;
+  }
+  return _beat;
+}
+
+uint8_t BeatDetectorBase::computeFlux(AudioFrequencyAnalysisBase *audioInfo, uint8_t offset, float &total)
+{
+  int length = min((int)audioInfo->_frequencyRangesLength, _rangeCapacity - offset);
+  float scale = _level > 0 ? _compression / _level : 0;
+  for (int r = 0; r < length; r++)
+  {
+    // log values, a rise counts the same in quiet and loud passages
+    float value = max(0.0f, audioInfo->_frequencyRanges[r]->_value);
+    _frameLevel = max(_frameLevel, value);
+    value = logf(1 + scale * value);
+    int i = offset + r;
+    if (i < _rangesLength)
+    {
+      total += max(0.0f, value - _previous[i]);
+    }
+    _previous[i] = value;
+  }
+  return offset + length;
+}
+
+void BeatDetectorBase::updateTempo(float onset)
+{
+  _history[_historyIndex] = onset;
+  // acf[lag] += onset[n] * onset[n - lag], older products fade by _acfDecay per tempo frame
+  int lags = min(2 * _maxLag + 2, (int)_lagCapacity);
+  int wrap = min(lags, _historyIndex + 1); // lags before the ring wraps, two straight loops
+  for (int lag = 0; lag < wrap; lag++)
+  {
+    _acf[lag] = _acf[lag] * _acfDecay + onset * _history[_historyIndex - lag];
+  }
+  for (int lag = wrap; lag < lags; lag++)
+  {
+    _acf[lag] = _acf[lag] * _acfDecay + onset * _history[_historyIndex + _lagCapacity - lag];
+  }
+  if (++_historyIndex >= _lagCapacity)
+  {
+    _historyIndex = 0;
+  }
+  estimateTempo();
+  estimatePhase();
+}
+
+float BeatDetectorBase::periodicity(int lag)
+{
+  // periods between two tempo frames split their peak over both lags
+  return _acf[lag] + max(_acf[lag - 1], _acf[lag + 1]);
+}
+
+float BeatDetectorBase::scoreLag(int lag)
+{
+  // a real beat period also repeats at twice the lag, half periods of it do not
+  return (periodicity(lag) + 0.5f * periodicity(2 * lag)) * _prior[lag - _minLag];
+}
+
+void BeatDetectorBase::estimateTempo()
+{
+  if (_acf[0] <= 0 || _minLag >= _maxLag)
+  {
+    _confidence = 0;
+    return;
+  }
+  int best = _minLag;
+  float bestScore = scoreLag(_minLag);
+  for (int lag = _minLag + 1; lag <= _maxLag; lag++)
+  {
+    float score = scoreLag(lag);
+    if (score > bestScore)
+    {
+      bestScore = score;
+      best = lag;
+    }
+  }
+  if (_lag > 0)
+  {
+    // only move to another tempo once it is clearly better than the current one
+    int current = min(max((int)(_lag + 0.5f), (int)_minLag), (int)_maxLag);
+    if (abs(best - current) > 1 && bestScore < scoreLag(current) * 1.2f)
+    {
+      best = current;
+      bestScore = scoreLag(current);
+    }
+  }
+
+  // parabola through the neighbours for the fractional period
+  float lag = best;
+  if (best > _minLag && best < _maxLag)
+  {
+    float a = scoreLag(best - 1);
+    float c = scoreLag(best + 1);
+    float d = a - 2 * bestScore + c;
+    if (d < 0)
+    {
+      lag += min(max(0.5f * (a - c) / d, -0.5f), 0.5f);
+    }
+  }
+  _lag = _lag > 0 && fabsf(lag - _lag) <= 1 ? _lag + 0.2f * (lag - _lag) : lag;
+  _period = _lag * _tempoFrameSeconds;
+  _confidence = min(periodicity(best) / (_acf[0] + _acf[1]), 1.0f);
+}
+
+void BeatDetectorBase::updatePhase()
+{
+  _sinceBeat += _frameSeconds;
+  if (_period > 0)
+  {
+    _phase += _frameSeconds / _period;
+    _phase -= (int)_phase;
+  }
+  float phase = _period > 0 ? _phase + _lookAheadSeconds / _period : _phase;
+  phase -= (int)phase;
+  if (isLocked())
+  {
+    // the predicted phase wrapped, a phase pulled back over the beat does not fire it twice
+    _beat = phase < _beatPhase - 0.5f && _sinceBeat > 0.5f * _period;
+  }
+  else
+  {
+    // no tempo to follow yet, beats are the onsets
+    _beat = _onset;
+  }
+  _beatPhase = phase;
+  if (_beat)
+  {
+    _sinceBeat = 0;
+  }
+}
+
+void BeatDetectorBase::estimatePhase()
+{
+  // comb over the last two periods of the history, the strongest offset is the last beat
+  int period = min((int)(_lag + 0.5f), (int)_maxLag);
+  if (period < 1)
+  {
+    return;
+  }
+  int newest = _historyIndex > 0 ? _historyIndex - 1 : _lagCapacity - 1;
+  int best = 0;
+  float bestSum = -1;
+  for (int offset = 0; offset < period; offset++)
+  {
+    int first = newest - offset;
+    first += first < 0 ? _lagCapacity : 0;
+    int second = first - period;
+    second += second < 0 ? _lagCapacity : 0;
+    float sum = _history[first] + _history[second];
+    if (sum > bestSum)
+    {
+      bestSum = sum;
+      best = offset;
+    }
+  }
+  float target = best / _lag; // phase of now when the last beat was best tempo frames ago
+  float error = _phase - target;
+  error -= error >= 0.5f ? 1 : error < -0.5f ? -1 : 0;
+  // locked beats are steered in gently, before that the phase simply follows
+  _phase -= isLocked() ? _phaseCorrection * error : error;
+  _phase += _phase < 0 ? 1 : 0;
+}
+
+void BeatDetectorBase::setFormat(int frameStep, int sampleRate)
+{
+  _frameStep = frameStep;
+  _sampleRate = sampleRate;
+  float frameSeconds = sampleRate > 0 ? (float)frameStep / sampleRate : 0;
+  if (frameSeconds <= 0)
+  {
+    _minLag = _maxLag = 0;
+    _tempoFrameSeconds = 0;
+    return;
+  }
+  // whole frames per tempo frame, so frames of the nominal step never straddle two tempo frames
+  _tempoFrameSeconds = frameSeconds * max(1, (int)ceilf(1 / (frameSeconds * BEAT_TEMPO_RATE)));
+  _acfDecay = expf(-_tempoFrameSeconds / _tempoSeconds);
+  _minLag = max(1, (int)(60 / (_maxBpm * _tempoFrameSeconds)));
+  _maxLag = min((int)ceilf(60 / (_minBpm * _tempoFrameSeconds)), _lagCapacity / 2 - 1);
+  for (int lag = _minLag; lag <= _maxLag; lag++)
+  {
+    // log normal around the preferred tempo, one octave wide
+    float octaves = log2f(60 / (lag * _tempoFrameSeconds) / _preferredBpm);
+    _prior[lag - _minLag] = expf(-0.5f * octaves * octaves);
+  }
+
+  // the period in seconds still holds, the autocorrelation is in the old tempo frames
+  for (int i = 0; i < _lagCapacity; i++)
+  {
+    _history[i] = 0;
+    _acf[i] = 0;
+  }
+  _historyIndex = 0;
+  _tempoElapsed = 0;
+  _tempoOnset = 0;
+  _lag = _period > 0 ? _period / _tempoFrameSeconds : 0;
+  _confidence = 0;
+}
+
+void BeatDetectorBase::reset()
+{
+  for (int i = 0; i < _rangeCapacity; i++)
+  {
+    _previous[i] = 0;
+  }
+  _rangesLength = 0;
+  _level = 0;
+  _flux = 0;
+  _fluxMean = 0;
+  _fluxDeviation = 0;
+  _threshold = 0;
+  _sinceOnset = 0;
+  _time = 0;
+  _onset = false;
+  _beat = false;
+  _period = 0;
+  _phase = 0;
+  _beatPhase = 0;
+  _sinceBeat = 0;
+  _frameStep = 0; // rebuilds the tempo tables and clears the autocorrelation on the next frame
+}
+
+void BeatDetectorBase::setTempoRange(float minBpm, float maxBpm)
+{
+  _minBpm = max(1.0f, min(minBpm, maxBpm));
+  _maxBpm = max(minBpm, maxBpm);
+  _frameStep = 0;
+}
+
+void BeatDetectorBase::setPreferredTempo(float bpm)
+{
+  _preferredBpm = bpm;
+  _frameStep = 0;
+}
+
+void BeatDetectorBase::setSensitivity(float sensitivity, float minimumFlux)
+{
+  _sensitivity = sensitivity;
+  _minimumFlux = minimumFlux;
+}
+
+void BeatDetectorBase::setLookAhead(float seconds)
+{
+  _lookAhead = seconds;
+}
+
+bool BeatDetectorBase::isOnset()
+{
+  return _onset;
+}
+
+bool BeatDetectorBase::isBeat()
+{
+  return _beat;
+}
+
+bool BeatDetectorBase::isLocked()
+{
+  return _period > 0 && _confidence >= _lockConfidence && _sinceOnset < _holdBeats * _period;
+}
+
+float BeatDetectorBase::getBPM()
+{
+  return _period > 0 ? 60 / _period : 0;
+}
+
+float BeatDetectorBase::getBeatPhase()
+{
+  return _beatPhase;
+}
+
+float BeatDetectorBase::getBeatPeriod()
+{
+  return _period;
+}
+
+float BeatDetectorBase::getConfidence()
+{
+  return _confidence;
+}
+
+float BeatDetectorBase::getOnsetStrength()
+{
+  return _flux;
+}
+
+float BeatDetectorBase::getThreshold()
+{
+  return _threshold;
+}
+
+#endif // BeatDetector_h
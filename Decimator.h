@@ -0,0 +1,108 @@
+#ifndef Decimator_h
+#define Decimator_h
+
+#include <stdint.h>
+#include <math.h>
+#include "RealFFT.h"
+
+/*
+    Decimator.h
+    By Shea Ivey
+
+    https://github.com/sheaivey/ESP32-AudioInI2S
+
+    Low pass filter and downsample by an integer factor in one step.
+    Polyphase: the FIR is only evaluated for the samples that are kept, so the cost
+    is taps / factor multiplies per input sample. The filter is a Hamming windowed
+    sinc with 16 taps per phase, flat to 0.4 of the output rate and below -43dB past
+    0.6 of it, so nothing aliases into the bottom 0.4 of the output rate.
+    Runs in fft_t like the FFT, Q31 taps with AUDIO_FIXED_POINT. Plain C++ so it can be used off-device.
+*/
+
+template <typename T>
+class Decimator
+{
+public:
+  Decimator() {}
+  Decimator(const Decimator &) = delete; // owns its taps and delay line
+  Decimator &operator=(const Decimator &) = delete;
+  ~Decimator()
+  {
+    delete[] _taps;
+    delete[] _delay;
+  }
+
+  void begin(uint8_t factor)
+  {
+    delete[] _taps;
+    delete[] _delay;
+    _factor = factor < 1 ? 1 : factor;
+    _tapsLength = _factor * 16;
+    _taps = new T[_tapsLength];
+    _delay = new T[_tapsLength * 2]; // doubled so the newest _tapsLength samples are always contiguous
+    double cutoff = 0.5 / _factor;   // output nyquist as a fraction of the input rate
+    double center = (_tapsLength - 1) / 2.0;
+    for (uint16_t i = 0; i < _tapsLength; i++)
+    {
+      double x = i - center;
+      double sinc = x == 0 ? 2 * cutoff : sin(TWO_PI * cutoff * x) / (M_PI * x);
+      double window = 0.54 - 0.46 * cos(TWO_PI * i / (_tapsLength - 1));
+      _taps[i] = FFTMath<T>::fromDouble(sinc * window);
+    }
+    reset();
+  }
+
+  void reset()
+  {
+    for (uint16_t i = 0; i < _tapsLength * 2; i++)
+    {
+      _delay[i] = 0;
+    }
+    _index = 0;
+    _phase = 0;
+  }
+
+  // filters length samples into out, returns the number of samples written (at most length / factor + 1)
+  template <typename sample_t>
+  int process(const sample_t *samples, int length, T *out)
+  {
+    int written = 0;
+    for (int i = 0; i < length; i++)
+    {
+      if (++_index == _tapsLength)
+      {
+        _index = 0;
+      }
+      _delay[_index] = _delay[_index + _tapsLength] = samples[i];
+      if (++_phase < _factor)
+      {
+        continue; // this output is dropped, never calculate it
+      }
+      _phase = 0;
+      // oldest to newest is _delay[_index + 1 .. _index + _tapsLength], the taps are symmetric
+      const T *window = &_delay[_index + 1];
+      typename FFTMath<T>::acc_t sum = 0;
+      for (uint16_t t = 0; t < _tapsLength; t++)
+      {
+        sum += FFTMath<T>::mul(window[t], _taps[t]);
+      }
+      out[written++] = FFTMath<T>::narrow(sum);
+    }
+    return written;
+  }
+
+  uint8_t factor()
+  {
+    return _factor;
+  }
+
+private:
+  T *_taps = nullptr;
+  T *_delay = nullptr;
+  uint16_t _tapsLength = 0;
+  uint16_t _index = 0;
+  uint8_t _factor = 1;
+  uint8_t _phase = 0;
+};
+
+#endif // Decimator_h
@@ -0,0 +1,896 @@
+#ifndef RealFFT_h
+#define RealFFT_h
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+/*
+    RealFFT.h
+    By Shea Ivey
+
+    https://github.com/sheaivey/ESP32-AudioInI2S
+
+    FFT for purely real input (microphone samples).
+    The N real samples are treated as N/2 complex samples, run through an N/2 point
+    complex FFT and then split back into the N/2 + 1 bins of the real spectrum.
+    Half the butterflies of a full complex FFT and only N/2 + 1 imaginary values.
+
+    Same call order as ArduinoFFT:
+      dcRemoval() -> windowing() -> compute() -> complexToMagnitude()
+    or prepare() in place of the first two, which also converts the samples, unwraps a
+    history ring and finds the sample min/max without any extra sweeps over memory.
+    After compute() real[k] and imag[k] hold bin k for k = 0 .. N/2.
+
+    The window is a table built once by the constructor or setWindow(), Hamming by default.
+    Other windows have a different coherent gain, windowScale() brings their bins back to
+    Hamming levels so noise floors and eq settings keep working when switching.
+
+    RealFFTPlans keeps one RealFFT per power of two size on the same buffers, so the
+    analyzers can change sample size at runtime without touching the heap.
+
+    Define AUDIO_FIXED_POINT before including the analysis headers to run everything
+    up to the per range sums in Q31 integers, for ESP32 C3/C2 which have no FPU.
+    Fixed point bins are scaled down by outputScale() to stay inside 32 bits. Quiet frames
+    are shifted up to full scale for the butterflies and back down once at the end, so the
+    per stage rounding does not eat the few bits they have.
+
+    The N/2 point complex FFT is a backend picked at compile time, the split pass,
+    windows and magnitudes stay the same for all of them:
+      ScalarFFT - portable radix-2, float and Q31. Always used with AUDIO_FIXED_POINT.
+      VectorFFT - float, 4 butterflies at a time with GCC vector extensions, so SSE2 on x86
+                  and NEON on ARM host builds. Picked automatically when available.
+      EspDspFFT - float, Espressif's ESP-DSP radix-2 FFT (assembly on ESP32/ESP32-S3).
+                  Define AUDIO_FFT_ESP_DSP before including the analysis headers.
+    Define AUDIO_FFT_SCALAR to always use ScalarFFT, or pass any class with the same
+    begin()/compute() functions as the second RealFFT template argument.
+*/
+
+#ifndef TWO_PI
+#define TWO_PI 6.283185307179586476925286766559
+#endif
+
+template <typename T>
+struct FFTMath;
+
+template <>
+struct FFTMath<float>
+{
+  typedef float acc_t;
+  static const uint8_t headroomShift = 0;
+  static const uint8_t stageShift = 0;
+
+  static float fromDouble(double v) { return v; }         // twiddle/window table values
+  static float mul(float a, float w) { return a * w; }    // value * twiddle/window
+  static float headroom(float a) { return a; }            // input scaling
+  static float down(float a, uint8_t) { return a; }       // extra input headroom, only needed in fixed point
+  static float up(float a, uint8_t) { return a; }         // block scaling of quiet frames, only needed in fixed point
+  static float roundDown(float a, uint8_t) { return a; }  // undoes up() on the bins
+  static uint8_t spareBits(const float *, uint16_t) { return 0; }
+  static float stage(float a) { return a; }               // per butterfly stage scaling
+  static float half(float a) { return a * 0.5f; }
+  static float magnitude(float re, float im) { return sqrt(re * re + im * im); }
+  static float exactMagnitude(float re, float im) { return sqrt(re * re + im * im); } // for values that already went through magnitude()
+  static float gate(float v) { return v; }                // threshold in bin units
+  static float narrow(float v) { return v; }              // accumulator back to a value
+
+  typedef float weight_t;                                 // per bin weights (fractional edges etc.)
+  static float toWeight(float w) { return w; }
+  static float weigh(float m, float w) { return m * w; }
+  static float weightScale() { return 1; }                // weighted sums to bin units
+};
+
+template <>
+struct FFTMath<int32_t>
+{
+  typedef int64_t acc_t;
+  static const uint8_t headroomShift = 2; // keeps the split pass inside 32 bits
+  static const uint8_t stageShift = 1;
+
+  static int32_t fromDouble(double v) { return v >= 1.0 ? INT32_MAX : (int32_t)lround(v * 2147483648.0); } // Q31
+  static int32_t mul(int32_t a, int32_t w) { return (int32_t)(((int64_t)a * w) >> 31); }
+  static int32_t headroom(int32_t a) { return a >> headroomShift; }
+  static int32_t down(int32_t a, uint8_t bits) { return a >> bits; }
+  static int32_t up(int32_t a, uint8_t bits) { return (int32_t)((uint32_t)a << bits); }
+  static int32_t roundDown(int32_t a, uint8_t bits) { return bits == 0 ? a : (int32_t)(((int64_t)a + ((int64_t)1 << (bits - 1))) >> bits); }
+  static uint8_t spareBits(const int32_t *values, uint16_t length)
+  {
+    // left shifts that keep the largest value within a full scale sample after headroom()
+    uint32_t peak = 0;
+    for (uint16_t i = 0; i < length; i++)
+    {
+      uint32_t a = values[i] < 0 ? -(uint32_t)values[i] : (uint32_t)values[i];
+      peak = a > peak ? a : peak;
+    }
+    uint8_t bits = 0;
+    while (peak != 0 && peak <= ((uint32_t)INT32_MAX >> (headroomShift + 1)))
+    {
+      peak <<= 1;
+      bits++;
+    }
+    return bits;
+  }
+  static int32_t stage(int32_t a) { return a >> stageShift; }
+  static int32_t half(int32_t a) { return a >> 1; }
+  static int32_t magnitude(int32_t re, int32_t im)
+  {
+    // alpha max plus beta min with two lines, max(max + 5/32 min, 27/32 max + 9/16 min) is within -1.1% / +1.4% of sqrt()
+    uint32_t a = re < 0 ? -(uint32_t)re : re;
+    uint32_t b = im < 0 ? -(uint32_t)im : im;
+    uint32_t mx = a > b ? a : b;
+    uint32_t mn = a > b ? b : a;
+    uint32_t near = mx + (mn >> 3) + (mn >> 5);
+    uint32_t far = mx - (mx >> 3) - (mx >> 5) + (mn >> 1) + (mn >> 4);
+    uint32_t approx = near > far ? near : far;
+    return approx > INT32_MAX ? INT32_MAX : approx;
+  }
+  static int32_t exactMagnitude(int32_t re, int32_t im)
+  {
+    // integer sqrt, so an approximated magnitude is not approximated a second time
+    uint64_t v = (uint64_t)((int64_t)re * re) + (uint64_t)((int64_t)im * im);
+    uint64_t result = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > v)
+    {
+      bit >>= 2;
+    }
+    while (bit != 0)
+    {
+      if (v >= result + bit)
+      {
+        v -= result + bit;
+        result = (result >> 1) + bit;
+      }
+      else
+      {
+        result >>= 1;
+      }
+      bit >>= 2;
+    }
+    return result > INT32_MAX ? INT32_MAX : (int32_t)result;
+  }
+  static int32_t gate(float v) { return !(v < 2147483647.0f) ? INT32_MAX : (int32_t)ceil(v); } // NaN/inf never pass
+  static int32_t narrow(int64_t v) { return v > INT32_MAX ? INT32_MAX : v < -INT32_MAX ? -INT32_MAX : (int32_t)v; } // saturates
+
+  typedef int32_t weight_t; // Q16
+  static int32_t toWeight(float w) { return !(w < 32767.0f) ? INT32_MAX : (int32_t)lround(w * 65536.0f); }
+  static int64_t weigh(int32_t m, int32_t w) { return (int64_t)m * w; }
+  static float weightScale() { return 1.0f / 65536.0f; }
+};
+
+#ifdef AUDIO_FIXED_POINT
+typedef int32_t fft_t;
+#else
+typedef float fft_t;
+#endif
+typedef FFTMath<fft_t>::acc_t fft_acc_t;
+typedef FFTMath<fft_t>::weight_t fft_weight_t;
+
+/* FFT Backends */
+
+// cos/sin of TWO_PI * k / (4 * quarter) for k < 2 * quarter, from a quarter wave sine table
+template <typename T>
+inline void fftTwiddle(const T *sin, uint16_t quarter, uint16_t k, T &c, T &s)
+{
+  if (k <= quarter)
+  {
+    c = sin[quarter - k];
+    s = sin[k];
+  }
+  else
+  {
+    c = -sin[k - quarter];
+    s = sin[(quarter << 1) - k];
+  }
+}
+
+template <typename T>
+class ScalarFFT
+{
+public:
+  static const char *name()
+  {
+    return "scalar";
+  }
+
+  // n point complex FFT, sin holds sin(TWO_PI * i / (2 * n)) for i = 0 .. n / 2 and must outlive the backend
+  void begin(uint16_t n, const T *sin)
+  {
+    _n = n;
+    _sin = sin;
+  }
+
+  // in place forward FFT of real + i imag, FFTMath<T>::stage() scaling per butterfly stage
+  void compute(T *real, T *imag)
+  {
+    bitReverse(real, imag);
+    for (uint16_t length = 2; length <= _n; length <<= 1)
+    {
+      stage(real, imag, length);
+    }
+  }
+
+protected:
+  void bitReverse(T *real, T *imag)
+  {
+    uint16_t j = 0;
+    for (uint16_t i = 0; i < _n - 1; i++)
+    {
+      if (i < j)
+      {
+        T tr = real[i];
+        real[i] = real[j];
+        real[j] = tr;
+        T ti = imag[i];
+        imag[i] = imag[j];
+        imag[j] = ti;
+      }
+      uint16_t k = _n >> 1;
+      while (k <= j)
+      {
+        j -= k;
+        k >>= 1;
+      }
+      j += k;
+    }
+  }
+
+  // radix-2 butterflies of one stage, twiddles of the n point FFT are the even twiddles of 2n
+  void stage(T *real, T *imag, uint16_t length)
+  {
+    uint16_t half = length >> 1;
+    uint16_t stride = (_n << 1) / length;
+    for (uint16_t k = 0; k < half; k++)
+    {
+      T c, s;
+      fftTwiddle(_sin, _n >> 1, k * stride, c, s);
+      for (uint16_t i = k; i < _n; i += length)
+      {
+        uint16_t l = i + half;
+        T lr = FFTMath<T>::stage(real[l]);
+        T li = FFTMath<T>::stage(imag[l]);
+        T tr = FFTMath<T>::mul(lr, c) + FFTMath<T>::mul(li, s);
+        T ti = FFTMath<T>::mul(li, c) - FFTMath<T>::mul(lr, s);
+        T ir = FFTMath<T>::stage(real[i]);
+        T ii = FFTMath<T>::stage(imag[i]);
+        real[l] = ir - tr;
+        imag[l] = ii - ti;
+        real[i] = ir + tr;
+        imag[i] = ii + ti;
+      }
+    }
+  }
+
+  uint16_t _n = 0;
+  const T *_sin = nullptr;
+};
+
+#if !defined(AUDIO_FFT_SCALAR) && defined(__GNUC__) && (defined(__SSE2__) || defined(__ARM_NEON))
+#define AUDIO_FFT_VECTOR
+
+// Same butterflies as ScalarFFT<float>, four k at a time. Stages with at least 4 butterflies
+// per group read their twiddles from one contiguous table per stage instead of strided.
+class VectorFFT : public ScalarFFT<float>
+{
+public:
+  typedef float v4sf __attribute__((vector_size(16)));
+
+  VectorFFT() {}
+  VectorFFT(const VectorFFT &) = delete; // owns its twiddle tables
+  VectorFFT &operator=(const VectorFFT &) = delete;
+  ~VectorFFT()
+  {
+    delete[] _cos4;
+    delete[] _sin4;
+  }
+
+  static const char *name()
+  {
+    return "vector";
+  }
+
+  void begin(uint16_t n, const float *sin)
+  {
+    ScalarFFT<float>::begin(n, sin);
+    delete[] _cos4;
+    delete[] _sin4;
+    _cos4 = new float[n];
+    _sin4 = new float[n];
+    // stage with half h keeps its twiddles at h - 4 .. 2h - 5
+    for (uint16_t half = 4; half < n; half <<= 1)
+    {
+      uint16_t stride = n / half;
+      for (uint16_t k = 0; k < half; k++)
+      {
+        fftTwiddle(sin, n >> 1, k * stride, _cos4[half - 4 + k], _sin4[half - 4 + k]);
+      }
+    }
+  }
+
+  void compute(float *real, float *imag)
+  {
+    bitReverse(real, imag);
+    uint16_t length = 2;
+    for (; length <= _n && length < 8; length <<= 1)
+    {
+      stage(real, imag, length);
+    }
+    for (; length <= _n; length <<= 1)
+    {
+      uint16_t half = length >> 1;
+      const float *cos4 = &_cos4[half - 4];
+      const float *sin4 = &_sin4[half - 4];
+      for (uint16_t i = 0; i < _n; i += length)
+      {
+        float *ar = &real[i];
+        float *ai = &imag[i];
+        float *br = &real[i + half];
+        float *bi = &imag[i + half];
+        for (uint16_t k = 0; k < half; k += 4)
+        {
+          v4sf c = load(&cos4[k]);
+          v4sf s = load(&sin4[k]);
+          v4sf lr = load(&br[k]);
+          v4sf li = load(&bi[k]);
+          v4sf tr = lr * c + li * s;
+          v4sf ti = li * c - lr * s;
+          v4sf ir = load(&ar[k]);
+          v4sf ii = load(&ai[k]);
+          store(&br[k], ir - tr);
+          store(&bi[k], ii - ti);
+          store(&ar[k], ir + tr);
+          store(&ai[k], ii + ti);
+        }
+      }
+    }
+  }
+
+private:
+  static v4sf load(const float *p)
+  {
+    v4sf v;
+    memcpy(&v, p, sizeof(v)); // unaligned load
+    return v;
+  }
+
+  static void store(float *p, v4sf v)
+  {
+    memcpy(p, &v, sizeof(v));
+  }
+
+  float *_cos4 = nullptr;
+  float *_sin4 = nullptr;
+};
+#endif
+
+#if defined(AUDIO_FFT_ESP_DSP) && !defined(AUDIO_FFT_SCALAR)
+#include <malloc.h>
+#include "esp_dsp.h"
+#ifndef CONFIG_DSP_MAX_FFT_SIZE
+#define CONFIG_DSP_MAX_FFT_SIZE 4096
+#endif
+
+// ESP-DSP works on interleaved re/im pairs, the split buffers are copied in and out.
+// Sizes above CONFIG_DSP_MAX_FFT_SIZE (ESP-DSP's shared twiddle table) fall back to ScalarFFT.
+class EspDspFFT : public ScalarFFT<float>
+{
+public:
+  EspDspFFT() {}
+  EspDspFFT(const EspDspFFT &) = delete; // owns its interleaved buffer
+  EspDspFFT &operator=(const EspDspFFT &) = delete;
+  ~EspDspFFT()
+  {
+    free(_data);
+  }
+
+  static const char *name()
+  {
+    return "esp-dsp";
+  }
+
+  void begin(uint16_t n, const float *sin)
+  {
+    ScalarFFT<float>::begin(n, sin);
+    free(_data);
+    _data = nullptr;
+    // one twiddle table for every size up to the max, later calls return right away
+    if (n <= CONFIG_DSP_MAX_FFT_SIZE && dsps_fft2r_init_fc32(NULL, CONFIG_DSP_MAX_FFT_SIZE) == ESP_OK)
+    {
+      _data = (float *)memalign(16, sizeof(float) * 2 * n);
+    }
+  }
+
+  void compute(float *real, float *imag)
+  {
+    if (_data == nullptr)
+    {
+      ScalarFFT<float>::compute(real, imag);
+      return;
+    }
+    for (uint16_t i = 0; i < _n; i++)
+    {
+      _data[i << 1] = real[i];
+      _data[(i << 1) + 1] = imag[i];
+    }
+    dsps_fft2r_fc32(_data, _n);
+    dsps_bit_rev_fc32(_data, _n);
+    for (uint16_t i = 0; i < _n; i++)
+    {
+      real[i] = _data[i << 1];
+      imag[i] = _data[(i << 1) + 1];
+    }
+  }
+
+private:
+  float *_data = nullptr;
+};
+#endif
+
+// backend RealFFT<T> uses unless one is passed in
+template <typename T>
+struct FFTBackendFor
+{
+  typedef ScalarFFT<T> type;
+};
+
+#if defined(AUDIO_FFT_ESP_DSP) && !defined(AUDIO_FFT_SCALAR)
+template <>
+struct FFTBackendFor<float>
+{
+  typedef EspDspFFT type;
+};
+#elif defined(AUDIO_FFT_VECTOR)
+template <>
+struct FFTBackendFor<float>
+{
+  typedef VectorFFT type;
+};
+#endif
+
+enum fft_window_t
+{
+  FFT_WINDOW_RECTANGLE = 0,
+  FFT_WINDOW_HAMMING,
+  FFT_WINDOW_HANN,
+  FFT_WINDOW_BLACKMAN_HARRIS, // -92dB side lobes, for quiet bins next to loud ones
+  FFT_WINDOW_FLAT_TOP,        // accurate peak amplitudes, wide main lobe
+};
+
+template <typename T, typename Backend = typename FFTBackendFor<T>::type>
+class RealFFT
+{
+public:
+  RealFFT(T *real, T *imag, uint16_t samples, fft_window_t window = FFT_WINDOW_HAMMING); // imag only needs samples / 2 + 1 values
+  RealFFT(const RealFFT &) = delete; // owns its sine and window tables
+  RealFFT &operator=(const RealFFT &) = delete;
+  ~RealFFT();
+
+  void dcRemoval();          // removes the mean from the samples
+  void windowing();          // applies the window to the samples
+  template <typename sample_t>
+  void prepare(const sample_t *samples, uint16_t offset, float &absMin, float &absMax, bool window = true); // real = dcRemoval(samples[offset ..] wrapped) windowed, absMin/absMax = smallest/largest |sample|
+  void compute();            // real samples -> bins 0 .. samples / 2
+  void complexToMagnitude(); // real[k] = |bin k|, imag[k] is left untouched
+  float outputScale();       // multiply bins by this to get unscaled FFT units (1 for float)
+
+  void setWindow(fft_window_t window); // rebuilds the window table, no allocation
+  fft_window_t getWindow();
+  float windowScale();                 // multiply windowed bins by this to get Hamming levels
+  float windowPower();                 // mean of the squared window, the part of a signal's power left after windowing
+  void setRunningMean(bool runningMean = true); // prepare() removes the mean of the previous frame, one sweep instead of two
+  T getMean();                                  // mean of the last prepare()
+  void setMean(T mean);                         // mean the next running mean prepare() removes, for signals sharing one plan
+
+  uint16_t samples()
+  {
+    return _samples;
+  }
+
+  uint16_t bins()
+  {
+    return _half + 1;
+  }
+
+  const char *backendName()
+  {
+    return Backend::name();
+  }
+
+private:
+  void twiddle(uint16_t k, T &c, T &s); // cos/sin of TWO_PI * k / samples for k < samples / 2
+
+  T *_real;
+  T *_imag;
+  uint16_t _samples;
+  uint16_t _half;
+  uint16_t _quarter;
+  T *_sin = nullptr;    // quarter wave sine table, samples / 4 + 1 values
+  Backend _backend;     // N/2 point complex FFT on real[0 .. N/2-1] + i imag[0 .. N/2-1]
+  T *_window = nullptr; // symmetric window, samples / 2 values
+  fft_window_t _windowType = FFT_WINDOW_HAMMING;
+  float _windowScale = 1;
+  float _windowPower = 1;
+  float _outputScale = 1;
+  bool _runningMean = false;
+  T _mean = 0; // of the last prepare()
+};
+
+// Every power of two size of one RealFFT on the same buffers. begin() builds the plans
+// (sine table, window, backend twiddles) up front, after that switching sizes only picks
+// another plan, nothing is allocated or freed while running.
+template <typename T, typename Backend = typename FFTBackendFor<T>::type>
+class RealFFTPlans
+{
+public:
+  RealFFTPlans(T *real, T *imag); // same buffers as RealFFT, sized for the largest plan
+  RealFFTPlans(const RealFFTPlans &) = delete; // owns its plans
+  RealFFTPlans &operator=(const RealFFTPlans &) = delete;
+  ~RealFFTPlans();
+
+  void begin(uint16_t minSamples, uint16_t maxSamples); // builds the plans of every power of two from minSamples to maxSamples
+  RealFFT<T, Backend> *get(uint16_t samples);          // plan for a power of two size, built on first use when begin() did not cover it
+  bool isPlanned(uint16_t samples);                    // plan already built, get() will not allocate
+
+  void setWindow(fft_window_t window); // applied to every plan, no allocation
+  void setRunningMean(bool runningMean = true);
+
+private:
+  static uint8_t slot(uint16_t samples); // log2 of samples
+
+  T *_real;
+  T *_imag;
+  fft_window_t _window = FFT_WINDOW_HAMMING;
+  bool _runningMean = false;
+  RealFFT<T, Backend> *_plans[16] = {}; // by log2 of the sample size
+};
+
+template <typename T, typename Backend>
+RealFFT<T, Backend>::RealFFT(T *real, T *imag, uint16_t samples, fft_window_t window)
+{
+  _real = real;
+  _imag = imag;
+  _samples = samples;
+  _half = samples >> 1;
+  _quarter = samples >> 2;
+
+  _sin = new T[_quarter + 1];
+  for (uint16_t i = 0; i <= _quarter; i++)
+  {
+    _sin[i] = FFTMath<T>::fromDouble(sin(TWO_PI * i / _samples));
+  }
+  _backend.begin(_half, _sin);
+
+  _window = new T[_half];
+  setWindow(window);
+
+  _outputScale = 1 << FFTMath<T>::headroomShift;
+  for (uint16_t n = 2; n <= _half; n <<= 1)
+  {
+    _outputScale *= 1 << FFTMath<T>::stageShift;
+  }
+}
+
+template <typename T, typename Backend>
+RealFFT<T, Backend>::~RealFFT()
+{
+  delete[] _sin;
+  delete[] _window;
+}
+
+template <typename T, typename Backend>
+void RealFFT<T, Backend>::dcRemoval()
+{
+  typename FFTMath<T>::acc_t mean = 0;
+  for (uint16_t i = 0; i < _samples; i++)
+  {
+    _real[i] = FFTMath<T>::headroom(_real[i]);
+    mean += _real[i];
+  }
+  mean /= _samples;
+  for (uint16_t i = 0; i < _samples; i++)
+  {
+    _real[i] -= (T)mean;
+  }
+}
+
+template <typename T, typename Backend>
+void RealFFT<T, Backend>::windowing()
+{
+  for (uint16_t i = 0; i < _half; i++)
+  {
+    _real[i] = FFTMath<T>::mul(_real[i], _window[i]);
+    _real[_samples - 1 - i] = FFTMath<T>::mul(_real[_samples - 1 - i], _window[i]);
+  }
+}
+
+template <typename T, typename Backend>
+template <typename sample_t>
+void RealFFT<T, Backend>::prepare(const sample_t *samples, uint16_t offset, float &absMin, float &absMax, bool window)
+{
+  float lo = fabs((float)samples[offset]);
+  float hi = lo;
+  typename FFTMath<T>::acc_t sum = 0;
+  if (_runningMean)
+  {
+    // one sweep, the mean of the last frame is close enough for a steady DC offset
+    for (uint16_t i = 0, j = offset; i < _samples; i++, j++)
+    {
+      if (j == _samples)
+      {
+        j = 0;
+      }
+      float a = fabs((float)samples[j]);
+      lo = a < lo ? a : lo;
+      hi = a > hi ? a : hi;
+      T v = FFTMath<T>::headroom((T)samples[j]);
+      sum += v;
+      v -= _mean;
+      _real[i] = window ? FFTMath<T>::mul(v, _window[i < _half ? i : _samples - 1 - i]) : v;
+    }
+    _mean = (T)(sum / _samples);
+  }
+  else
+  {
+    // convert and find the mean, then remove it and window both halves in a second sweep
+    for (uint16_t i = 0, j = offset; i < _samples; i++, j++)
+    {
+      if (j == _samples)
+      {
+        j = 0;
+      }
+      float a = fabs((float)samples[j]);
+      lo = a < lo ? a : lo;
+      hi = a > hi ? a : hi;
+      T v = FFTMath<T>::headroom((T)samples[j]);
+      _real[i] = v;
+      sum += v;
+    }
+    _mean = (T)(sum / _samples);
+    for (uint16_t i = 0; i < _half; i++)
+    {
+      T a = _real[i] - _mean;
+      T b = _real[_samples - 1 - i] - _mean;
+      _real[i] = window ? FFTMath<T>::mul(a, _window[i]) : a;
+      _real[_samples - 1 - i] = window ? FFTMath<T>::mul(b, _window[i]) : b;
+    }
+  }
+  absMin = lo;
+  absMax = hi;
+}
+
+template <typename T, typename Backend>
+void RealFFT<T, Backend>::setWindow(fft_window_t window)
+{
+  _windowType = window;
+  double sum = 0;
+  double powerSum = 0;
+  double hammingSum = 0;
+  for (uint16_t i = 0; i < _half; i++)
+  {
+    double x = TWO_PI * i / (_samples - 1);
+    double hamming = 0.54 - (0.46 * cos(x));
+    double w;
+    switch (window)
+    {
+    case FFT_WINDOW_RECTANGLE:
+      w = 1;
+      break;
+    case FFT_WINDOW_HANN:
+      w = 0.5 - 0.5 * cos(x);
+      break;
+    case FFT_WINDOW_BLACKMAN_HARRIS:
+      w = 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2 * x) - 0.01168 * cos(3 * x);
+      break;
+    case FFT_WINDOW_FLAT_TOP:
+      w = 0.21557895 - 0.41663158 * cos(x) + 0.277263158 * cos(2 * x) - 0.083578947 * cos(3 * x) + 0.006947368 * cos(4 * x);
+      break;
+    case FFT_WINDOW_HAMMING:
+    default:
+      w = hamming;
+      break;
+    }
+    _window[i] = FFTMath<T>::fromDouble(w);
+    sum += w;
+    powerSum += w * w;
+    hammingSum += hamming;
+  }
+  _windowScale = window == FFT_WINDOW_HAMMING || sum <= 0 ? 1 : hammingSum / sum; // coherent gain relative to Hamming
+  _windowPower = powerSum / _half;
+}
+
+template <typename T, typename Backend>
+fft_window_t RealFFT<T, Backend>::getWindow()
+{
+  return _windowType;
+}
+
+template <typename T, typename Backend>
+float RealFFT<T, Backend>::windowScale()
+{
+  return _windowScale;
+}
+
+template <typename T, typename Backend>
+float RealFFT<T, Backend>::windowPower()
+{
+  return _windowPower;
+}
+
+template <typename T, typename Backend>
+void RealFFT<T, Backend>::setRunningMean(bool runningMean)
+{
+  _runningMean = runningMean;
+}
+
+template <typename T, typename Backend>
+T RealFFT<T, Backend>::getMean()
+{
+  return _mean;
+}
+
+template <typename T, typename Backend>
+void RealFFT<T, Backend>::setMean(T mean)
+{
+  _mean = mean;
+}
+
+template <typename T, typename Backend>
+void RealFFT<T, Backend>::twiddle(uint16_t k, T &c, T &s)
+{
+  fftTwiddle(_sin, _quarter, k, c, s);
+}
+
+template <typename T, typename Backend>
+void RealFFT<T, Backend>::compute()
+{
+  // fixed point: every stage rounds off a bit, run quiet frames at full scale
+  uint8_t shift = FFTMath<T>::spareBits(_real, _samples);
+
+  // even samples become the real part, odd samples the imaginary part.
+  // reading 2i / 2i+1 never hits a slot that was already written.
+  for (uint16_t i = 0; i < _half; i++)
+  {
+    _imag[i] = FFTMath<T>::up(_real[(i << 1) + 1], shift);
+    _real[i] = FFTMath<T>::up(_real[i << 1], shift);
+  }
+
+  _backend.compute(_real, _imag);
+
+  // split Z into the spectrum of the real signal, pairs k and N/2-k share inputs
+  T zr = _real[0];
+  T zi = _imag[0];
+  _real[0] = zr + zi;
+  _imag[0] = 0;
+  _real[_half] = zr - zi;
+  _imag[_half] = 0;
+  for (uint16_t k = 1; k <= (_half >> 1); k++)
+  {
+    uint16_t m = _half - k;
+    T ar = _real[k], ai = _imag[k];
+    T br = _real[m], bi = _imag[m];
+    // even = (Z[k] + conj(Z[m])) / 2, odd = (Z[k] - conj(Z[m])) / 2i
+    T er = FFTMath<T>::half(ar) + FFTMath<T>::half(br);
+    T ei = FFTMath<T>::half(ai) - FFTMath<T>::half(bi);
+    T or_ = FFTMath<T>::half(ai) + FFTMath<T>::half(bi);
+    T oi = FFTMath<T>::half(br) - FFTMath<T>::half(ar);
+    T c, s;
+    twiddle(k, c, s);
+    // W = cos - i sin
+    T tr = FFTMath<T>::mul(or_, c) + FFTMath<T>::mul(oi, s);
+    T ti = FFTMath<T>::mul(oi, c) - FFTMath<T>::mul(or_, s);
+    _real[k] = er + tr;
+    _imag[k] = ei + ti;
+    _real[m] = er - tr;
+    _imag[m] = ti - ei;
+  }
+
+  if (shift > 0)
+  {
+    for (uint16_t k = 0; k <= _half; k++)
+    {
+      _real[k] = FFTMath<T>::roundDown(_real[k], shift);
+      _imag[k] = FFTMath<T>::roundDown(_imag[k], shift);
+    }
+  }
+}
+
+template <typename T, typename Backend>
+void RealFFT<T, Backend>::complexToMagnitude()
+{
+  for (uint16_t i = 0; i <= _half; i++)
+  {
+    _real[i] = FFTMath<T>::magnitude(_real[i], _imag[i]);
+  }
+}
+
+template <typename T, typename Backend>
+float RealFFT<T, Backend>::outputScale()
+{
+  return _outputScale;
+}
+
+template <typename T, typename Backend>
+RealFFTPlans<T, Backend>::RealFFTPlans(T *real, T *imag)
+{
+  _real = real;
+  _imag = imag;
+}
+
+template <typename T, typename Backend>
+RealFFTPlans<T, Backend>::~RealFFTPlans()
+{
+  for (uint8_t i = 0; i < 16; i++)
+  {
+    delete _plans[i];
+  }
+}
+
+template <typename T, typename Backend>
+uint8_t RealFFTPlans<T, Backend>::slot(uint16_t samples)
+{
+  uint8_t bits = 0;
+  while (samples > 1)
+  {
+    samples >>= 1;
+    bits++;
+  }
+  return bits;
+}
+
+template <typename T, typename Backend>
+void RealFFTPlans<T, Backend>::begin(uint16_t minSamples, uint16_t maxSamples)
+{
+  for (uint32_t n = 4; n <= maxSamples; n <<= 1)
+  {
+    if (n >= minSamples)
+    {
+      get(n);
+    }
+  }
+}
+
+template <typename T, typename Backend>
+RealFFT<T, Backend> *RealFFTPlans<T, Backend>::get(uint16_t samples)
+{
+  RealFFT<T, Backend> *&plan = _plans[slot(samples)];
+  if (plan == nullptr)
+  {
+    plan = new RealFFT<T, Backend>(_real, _imag, samples, _window);
+    plan->setRunningMean(_runningMean);
+  }
+  return plan;
+}
+
+template <typename T, typename Backend>
+bool RealFFTPlans<T, Backend>::isPlanned(uint16_t samples)
+{
+  return _plans[slot(samples)] != nullptr;
+}
+
+template <typename T, typename Backend>
+void RealFFTPlans<T, Backend>::setWindow(fft_window_t window)
+{
+  _window = window;
+  for (uint8_t i = 0; i < 16; i++)
+  {
+    if (_plans[i] != nullptr && _plans[i]->getWindow() != window)
+    {
+      _plans[i]->setWindow(window);
+    }
+  }
+}
+
+template <typename T, typename Backend>
+void RealFFTPlans<T, Backend>::setRunningMean(bool runningMean)
+{
+  _runningMean = runningMean;
+  for (uint8_t i = 0; i < 16; i++)
+  {
+    if (_plans[i] != nullptr)
+    {
+      _plans[i]->setRunningMean(runningMean);
+    }
+  }
+}
+
+#endif // RealFFT_h
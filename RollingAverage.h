@@ -1,6 +1,8 @@
 #ifndef RollingAverage_h
 #define RollingAverage_h
 
+#include <stdint.h>
+
 #define MAX_ROLLING_AVERAGE_WINDOW 50
 
 /*
@@ -0,0 +1,125 @@
+#ifndef SampleRingBuffer_h
+#define SampleRingBuffer_h
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+/*
+    SampleRingBuffer.h
+    By Shea Ivey
+
+    https://github.com/sheaivey/ESP32-AudioInI2S
+
+    Lock-free single producer / single consumer ring of samples.
+    The producer (I2S DMA task) only moves _head, the consumer (loop) only moves _tail,
+    so neither side ever blocks the other. Plain C++ so it can be used off-device.
+*/
+
+template <typename T>
+class SampleRingBuffer
+{
+public:
+  ~SampleRingBuffer()
+  {
+    delete[] _buffer;
+  }
+
+  void begin(uint32_t capacity)
+  {
+    // round up to a power of two so wrapping is a mask
+    _capacity = 1;
+    while (_capacity < capacity)
+    {
+      _capacity <<= 1;
+    }
+    _mask = _capacity - 1;
+    delete[] _buffer;
+    _buffer = new T[_capacity];
+    _head.store(0);
+    _tail.store(0);
+    _overruns.store(0);
+  }
+
+  // producer side, writes the whole chunk or drops it and counts an overrun.
+  uint32_t write(const T *samples, uint32_t length)
+  {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+    if (_buffer == nullptr || length > _capacity - (head - tail))
+    {
+      _overruns.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+    }
+    copyIn(head & _mask, samples, length);
+    _head.store(head + length, std::memory_order_release);
+    return length;
+  }
+
+  // consumer side, reads up to length samples without blocking.
+  uint32_t read(T *samples, uint32_t length)
+  {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    uint32_t head = _head.load(std::memory_order_acquire);
+    uint32_t count = head - tail;
+    if (length > count)
+    {
+      length = count;
+    }
+    copyOut(tail & _mask, samples, length);
+    _tail.store(tail + length, std::memory_order_release);
+    return length;
+  }
+
+  // consumer side, drops the oldest samples.
+  uint32_t skip(uint32_t length)
+  {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    uint32_t count = _head.load(std::memory_order_acquire) - tail;
+    if (length > count)
+    {
+      length = count;
+    }
+    _tail.store(tail + length, std::memory_order_release);
+    return length;
+  }
+
+  uint32_t available()
+  {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+  }
+
+  uint32_t capacity()
+  {
+    return _capacity;
+  }
+
+  uint32_t getOverruns()
+  {
+    return _overruns.load(std::memory_order_relaxed);
+  }
+
+private:
+  void copyIn(uint32_t index, const T *samples, uint32_t length)
+  {
+    uint32_t first = _capacity - index < length ? _capacity - index : length;
+    memcpy(&_buffer[index], samples, sizeof(T) * first);
+    memcpy(_buffer, &samples[first], sizeof(T) * (length - first));
+  }
+
+  void copyOut(uint32_t index, T *samples, uint32_t length)
+  {
+    uint32_t first = _capacity - index < length ? _capacity - index : length;
+    memcpy(samples, &_buffer[index], sizeof(T) * first);
+    memcpy(&samples[first], _buffer, sizeof(T) * (length - first));
+  }
+
+  T *_buffer = nullptr;
+  uint32_t _capacity = 0;
+  uint32_t _mask = 0;
+  std::atomic<uint32_t> _head{0};     // total samples written, producer owned
+  std::atomic<uint32_t> _tail{0};     // total samples read, consumer owned
+  std::atomic<uint32_t> _overruns{0}; // chunks dropped because the consumer fell behind
+};
+
+#endif // SampleRingBuffer_h
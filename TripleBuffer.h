@@ -0,0 +1,62 @@
+#ifndef TripleBuffer_h
+#define TripleBuffer_h
+
+#include <stdint.h>
+#include <atomic>
+
+/*
+    TripleBuffer.h
+    By Shea Ivey
+
+    https://github.com/sheaivey/ESP32-AudioInI2S
+
+    Lock-free hand off of whole frames between one writer and one reader.
+    The writer fills writeBuffer() and publish()es it, the reader update()s and
+    then uses readBuffer(). Neither side ever waits, the reader simply keeps the
+    last frame until a newer one is published. Plain C++ so it can be used off-device.
+*/
+
+template <typename T>
+class TripleBuffer
+{
+public:
+  // writer side
+  T &writeBuffer()
+  {
+    return _buffers[_write];
+  }
+
+  void publish()
+  {
+    uint8_t previous = _middle.exchange(_write | DIRTY, std::memory_order_acq_rel);
+    _write = previous & INDEX;
+  }
+
+  // reader side, returns true when a newer frame was swapped in
+  bool update()
+  {
+    if (!(_middle.load(std::memory_order_acquire) & DIRTY))
+    {
+      return false;
+    }
+    uint8_t previous = _middle.exchange(_read, std::memory_order_acq_rel);
+    _read = previous & INDEX;
+    return true;
+  }
+
+  const T &readBuffer()
+  {
+    return _buffers[_read];
+  }
+
+private:
+  static const uint8_t INDEX = 0x03;
+  static const uint8_t DIRTY = 0x04; // middle buffer holds a frame the reader has not seen
+
+  T _buffers[3];
+  uint8_t _write = 0; // writer owned
+  uint8_t _read = 1;  // reader owned
+  std::atomic<uint8_t> _middle{2};
+};
+
+#endif // TripleBuffer_h
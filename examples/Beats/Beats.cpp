@@ -0,0 +1,171 @@
+/*
+    Beats.cpp
+    By Shea Ivey
+
+    Runs BeatDetector over a WAV file on a desktop (Linux, macOS) and prints every beat with the tempo.
+    Given a label file of beat times in seconds (first number on each line, like the .beats files of
+    most beat tracking datasets) it scores the beats with the F-measure at +-70ms, precision and recall.
+    A minimum F-measure makes it exit with 1 below it, so labelled clips can be used as regression tests.
+    Build from the library folder:
+      g++ -std=gnu++11 -O2 -I. examples/Beats/Beats.cpp -o beats -lpthread
+      ./beats song.wav                    // beats and tempo
+      ./beats song.wav song.beats         // scored against the labels
+      ./beats song.wav song.beats 0.8     // exits with 1 when the F-measure is below 0.8
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <AudioInI2S.h>
+
+#define SAMPLE_SIZE 1024 // FFT window
+#define HOP_SIZE 512     // new samples per frame, 86 frames per second at 44100Hz
+#define SAMPLE_RATE 44100
+#define RANGES 16        // log spaced ranges the flux is calculated over
+#define MAX_BEATS 8192
+#define TOLERANCE 0.07   // seconds
+
+#include <AudioFrequencyAnalysis.h>
+#include <BeatDetector.h>
+AudioFrequencyAnalysisT<SAMPLE_SIZE, RANGES> audioInfo;
+BeatDetectorT<RANGES> beat;
+
+AudioInI2S mic; // no pins on the host
+
+int32_t hop[HOP_SIZE];
+float beats[MAX_BEATS];
+float labels[MAX_BEATS];
+
+int readLabels(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  if (file == nullptr)
+  {
+    return -1;
+  }
+  int count = 0;
+  char line[256];
+  while (count < MAX_BEATS && fgets(line, sizeof(line), file) != nullptr)
+  {
+    char *end;
+    float seconds = strtof(line, &end);
+    if (end != line)
+    {
+      labels[count++] = seconds;
+    }
+  }
+  fclose(file);
+  return count;
+}
+
+// every label matches at most one beat within the tolerance, both lists are in time order
+int countMatches(int beatCount, int labelCount)
+{
+  int matches = 0;
+  int b = 0;
+  for (int l = 0; l < labelCount; l++)
+  {
+    while (b < beatCount && beats[b] < labels[l] - TOLERANCE)
+    {
+      b++;
+    }
+    if (b < beatCount && beats[b] <= labels[l] + TOLERANCE)
+    {
+      matches++;
+      b++;
+    }
+  }
+  return matches;
+}
+
+// average distance of every beat to the nearest label within the tolerance, positive = late
+float meanError(int beatCount, int labelCount)
+{
+  float sum = 0;
+  int count = 0;
+  int l = 0;
+  for (int b = 0; b < beatCount; b++)
+  {
+    while (l + 1 < labelCount && fabsf(labels[l + 1] - beats[b]) < fabsf(labels[l] - beats[b]))
+    {
+      l++;
+    }
+    if (l < labelCount && fabsf(beats[b] - labels[l]) <= TOLERANCE)
+    {
+      sum += beats[b] - labels[l];
+      count++;
+    }
+  }
+  return count > 0 ? sum / count : 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    printf("usage: %s song.wav [song.beats] [min F-measure]\n", argv[0]);
+    return 1;
+  }
+  mic.begin(SAMPLE_SIZE, SAMPLE_RATE);
+  mic.setRealtime(false);
+  if (!mic.openWav(argv[1]))
+  {
+    printf("can not read %s\n", argv[1]);
+    return 1;
+  }
+  int sampleRate = mic.getSourceSampleRate(); // beat times follow the file
+
+  // log spaced ranges from 40Hz up, onsets in every part of the spectrum count
+  for (int r = 0; r < RANGES; r++)
+  {
+    float low = 40 * powf(400, (float)r / RANGES);
+    float high = 40 * powf(400, (float)(r + 1) / RANGES);
+    audioInfo.addFrequencyRange(new FrequencyRange(low, high - 1));
+  }
+  audioInfo.setHopSize(HOP_SIZE);
+  beat.setLookAhead(-1); // beats fire when the analyzed sound is heard, not one window late
+
+  int beatCount = 0;
+  uint32_t frames = 0;
+  uint32_t position = 0; // samples read
+  unsigned long elapsed = 0; // microseconds in process()
+  while (mic.read(hop, HOP_SIZE) == HOP_SIZE)
+  {
+    position += HOP_SIZE;
+    if (!audioInfo.stream(hop, HOP_SIZE, SAMPLE_SIZE, sampleRate))
+    {
+      continue;
+    }
+    unsigned long start = micros();
+    bool isBeat = beat.process(&audioInfo);
+    elapsed += micros() - start;
+    frames++;
+    if (isBeat && beatCount < MAX_BEATS)
+    {
+      beats[beatCount] = (float)position / sampleRate; // when the newest sample arrived
+      printf("beat %8.3fs, bpm: %6.1f, confidence: %4.2f%s\n", beats[beatCount], beat.getBPM(), beat.getConfidence(), beat.isLocked() ? "" : ", onset");
+      beatCount++;
+    }
+  }
+  printf("%d beats, bpm: %.1f, confidence: %.2f, latency: %.1fms, %.2fus per frame\n", beatCount, beat.getBPM(), beat.getConfidence(), audioInfo.getLatency() * 1000, frames > 0 ? (float)elapsed / frames : 0);
+
+  if (argc > 2)
+  {
+    int labelCount = readLabels(argv[2]);
+    if (labelCount < 0)
+    {
+      printf("can not read %s\n", argv[2]);
+      return 1;
+    }
+    int matches = countMatches(beatCount, labelCount);
+    printf("mean error: %+.1fms\n", meanError(beatCount, labelCount) * 1000);
+    float precision = beatCount > 0 ? (float)matches / beatCount : 0;
+    float recall = labelCount > 0 ? (float)matches / labelCount : 0;
+    float fMeasure = precision + recall > 0 ? 2 * precision * recall / (precision + recall) : 0;
+    printf("F-measure: %.3f, precision: %.3f, recall: %.3f (%d of %d labels)\n", fMeasure, precision, recall, matches, labelCount);
+    if (argc > 3 && fMeasure < atof(argv[3]))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,228 @@
+/*
+    Benchmark.cpp
+    By Shea Ivey
+
+    Times every stage of AudioAnalysis and AudioFrequencyAnalysis natively on Linux/macOS
+    across sample sizes 256 - 4096, band counts 2 - 64 and range counts 1 - 64.
+    Prints one CSV row per stage, paste it into a spreadsheet or diff two runs to catch regressions.
+    Build from the library folder, add -DAUDIO_FIXED_POINT to time the integer FFT
+    or -DAUDIO_FFT_SCALAR to time the portable FFT backend instead of the vectorized one:
+      g++ -std=gnu++11 -O2 -I. examples/Benchmark/Benchmark.cpp -o benchmark -lpthread
+      ./benchmark          // 100ms per configuration
+      ./benchmark 1000     // 1s per configuration, steadier numbers
+    Columns:
+      analyzer,math,fft,stage,sample_size,bands,ranges,ns_per_frame,frames_per_sec
+    The stages of one analyzer add up to its total row plus the cost of reading the clock.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <AudioInI2S.h>
+
+#define SAMPLE_SIZE 4096 // largest sample size benchmarked
+#define SAMPLE_RATE 44100
+#define BAND_SIZE 64
+#define BAND_SIZE_PADDING 0
+
+#include <AudioAnalysis.h>
+#include <AudioFrequencyAnalysis.h>
+
+#ifdef AUDIO_FIXED_POINT
+#define MATH "q31"
+#else
+#define MATH "float"
+#endif
+
+const int sampleSizes[] = {256, 512, 1024, 2048, 4096};
+const int bandSizes[] = {2, 4, 8, 16, 32, 64};
+const int rangeSizes[] = {1, 4, 16, 64};
+
+enum stage_type
+{
+  STAGE_PREP,      // convert, dcRemoval, windowing and sample min/max scan in one pass
+  STAGE_FFT,       // compute()
+  STAGE_MAGNITUDE, // complexToMagnitude()
+  STAGE_BANDS,     // computeFrequencies() / range aggregation
+  STAGE_UPDATE,    // FrequencyRange::loop() of every range
+  STAGE_TOTAL,     // the public call, timed on its own
+  STAGE_COUNT
+};
+
+const char *stageNames[STAGE_COUNT] = {"prep", "compute", "complexToMagnitude", "bands", "update", "total"};
+
+int32_t samples[SAMPLE_SIZE];
+float minTimeMs = 100;
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct StageTimer
+{
+  double ns[STAGE_COUNT];
+  bench_clock::time_point last;
+
+  void reset()
+  {
+    for (int i = 0; i < STAGE_COUNT; i++)
+    {
+      ns[i] = 0;
+    }
+  }
+
+  void start()
+  {
+    last = bench_clock::now();
+  }
+
+  void lap(stage_type stage)
+  {
+    bench_clock::time_point now = bench_clock::now();
+    ns[stage] += std::chrono::duration<double, std::nano>(now - last).count();
+    last = now;
+  }
+};
+
+StageTimer timer;
+
+void fillSamples()
+{
+  // two tones and some noise at INMP441 scale so every stage does real work
+  uint32_t seed = 1;
+  for (int i = 0; i < SAMPLE_SIZE; i++)
+  {
+    seed = seed * 1664525 + 1013904223;
+    float noise = (int32_t)seed / 2147483648.0f;
+    float v = 0.3f * sin(TWO_PI * 440.0 * i / SAMPLE_RATE) + 0.2f * sin(TWO_PI * 3520.0 * i / SAMPLE_RATE) + 0.01f * noise;
+    samples[i] = (int32_t)(v * 2147483647.0f);
+  }
+}
+
+void report(const char *analyzer, int sampleSize, int bands, int ranges, uint32_t frames, stage_type first, stage_type last)
+{
+  for (int s = first; s <= last; s++)
+  {
+    double ns = timer.ns[s] / frames;
+    printf("%s,%s,%s,%s,%d,%d,%d,%.0f,%.1f\n", analyzer, MATH, FFTBackendFor<fft_t>::type::name(), stageNames[s], sampleSize, bands, ranges, ns, ns > 0 ? 1e9 / ns : 0);
+  }
+}
+
+// runs step until minTimeMs passed, returns the frames it ran (after a short warm up)
+template <typename F>
+uint32_t run(F step)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    step();
+  }
+  timer.reset();
+  uint32_t frames = 0;
+  bench_clock::time_point start = bench_clock::now();
+  do
+  {
+    step();
+    frames++;
+  } while (std::chrono::duration<double, std::milli>(bench_clock::now() - start).count() < minTimeMs);
+  return frames;
+}
+
+// protected stages of AudioAnalysis
+class AudioAnalysisBench : public AudioAnalysisT<SAMPLE_SIZE, BAND_SIZE>
+{
+public:
+  void stages(int bands)
+  {
+    timer.start();
+    prepSamples(samples);
+    timer.lap(STAGE_PREP);
+    _FFT->compute();
+    timer.lap(STAGE_FFT);
+    _FFT->complexToMagnitude();
+    timer.lap(STAGE_MAGNITUDE);
+    computeFrequencies(bands);
+    timer.lap(STAGE_BANDS);
+  }
+};
+
+AudioAnalysisBench audioAnalysis;
+
+void benchAudioAnalysis(int sampleSize, int bands)
+{
+  audioAnalysis.computeFFT(samples, sampleSize, SAMPLE_RATE); // picks the FFT plan for this size
+  uint32_t frames = run([&]() { audioAnalysis.stages(bands); });
+  report("AudioAnalysis", sampleSize, bands, 0, frames, STAGE_PREP, STAGE_BANDS);
+
+  frames = run([&]() {
+    timer.start();
+    audioAnalysis.computeFFT(samples, sampleSize, SAMPLE_RATE);
+    audioAnalysis.computeFrequencies(bands);
+    timer.lap(STAGE_TOTAL);
+  });
+  report("AudioAnalysis", sampleSize, bands, 0, frames, STAGE_TOTAL, STAGE_TOTAL);
+}
+
+void benchAudioFrequencyAnalysis(int sampleSize, int rangesLength)
+{
+  AudioFrequencyAnalysisT<SAMPLE_SIZE, BAND_SIZE> *audioInfo = new AudioFrequencyAnalysisT<SAMPLE_SIZE, BAND_SIZE>();
+  FrequencyRange *ranges[BAND_SIZE];
+  for (int r = 0; r < rangesLength; r++)
+  {
+    // log spaced 20Hz - 20kHz, like a spectrum display
+    float low = 20 * pow(1000.0, (float)r / rangesLength);
+    float high = 20 * pow(1000.0, (float)(r + 1) / rangesLength);
+    ranges[r] = new FrequencyRange(low, high - 1);
+    audioInfo->addFrequencyRange(ranges[r]);
+  }
+  audioInfo->loop(samples, sampleSize, SAMPLE_RATE); // creates the FFT plan and bin table for this size
+
+  uint32_t frames = run([&]() {
+    timer.start();
+    audioInfo->prepSamples();
+    timer.lap(STAGE_PREP);
+    audioInfo->_FFT->compute();
+    timer.lap(STAGE_FFT);
+    audioInfo->_FFT->complexToMagnitude();
+    timer.lap(STAGE_MAGNITUDE);
+    audioInfo->sumBins();
+    timer.lap(STAGE_BANDS);
+    audioInfo->updateRanges();
+    timer.lap(STAGE_UPDATE);
+  });
+  report("AudioFrequencyAnalysis", sampleSize, 0, rangesLength, frames, STAGE_PREP, STAGE_UPDATE);
+
+  frames = run([&]() {
+    timer.start();
+    audioInfo->loop(samples, sampleSize, SAMPLE_RATE);
+    timer.lap(STAGE_TOTAL);
+  });
+  report("AudioFrequencyAnalysis", sampleSize, 0, rangesLength, frames, STAGE_TOTAL, STAGE_TOTAL);
+
+  for (int r = 0; r < rangesLength; r++)
+  {
+    delete ranges[r];
+  }
+  delete audioInfo;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1)
+  {
+    minTimeMs = atof(argv[1]);
+  }
+  fillSamples();
+  audioAnalysis.begin(sampleSizes[0]); // every size planned up front, like a long running firmware
+
+  printf("analyzer,math,fft,stage,sample_size,bands,ranges,ns_per_frame,frames_per_sec\n");
+  for (int sampleSize : sampleSizes)
+  {
+    for (int bands : bandSizes)
+    {
+      benchAudioAnalysis(sampleSize, bands);
+    }
+    for (int ranges : rangeSizes)
+    {
+      benchAudioFrequencyAnalysis(sampleSize, ranges);
+    }
+  }
+  return 0;
+}
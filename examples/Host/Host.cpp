@@ -0,0 +1,73 @@
+/*
+    Host.cpp
+    By Shea Ivey
+
+    Runs the FrequencyRange example on a desktop (Linux, macOS) without an ESP32.
+    AudioInI2S reads a WAV file instead of the microphone, or a 1kHz sine when no file is given.
+    Build from the library folder:
+      g++ -std=gnu++11 -O2 -I. examples/Host/Host.cpp -o host -lpthread
+      ./host song.wav            // as fast as possible
+      ./host song.wav realtime   // paced at SAMPLE_RATE like the microphone
+*/
+
+#include <stdio.h>
+#include <AudioInI2S.h>
+
+#define SAMPLE_SIZE 1024  // Buffer size of read samples
+#define SAMPLE_RATE 44100 // Audio Sample Rate
+
+#include <AudioFrequencyAnalysis.h>
+AudioFrequencyAnalysis audioInfo;
+
+AudioInI2S mic; // no pins on the host
+
+int32_t samples[SAMPLE_SIZE];
+
+FrequencyRange vuMeter(0, 20000);
+FrequencyRange bass(0, 249);
+FrequencyRange mid(250, 1499);
+FrequencyRange high(1500, 16000);
+
+float sine(uint32_t index, int sampleRate)
+{
+  return 0.5f * sin(TWO_PI * 1000.0 * index / sampleRate);
+}
+
+int main(int argc, char **argv)
+{
+  mic.begin(SAMPLE_SIZE, SAMPLE_RATE);
+  mic.setRealtime(argc > 2);
+  if (argc > 1)
+  {
+    if (!mic.openWav(argv[1]))
+    {
+      printf("can not read %s\n", argv[1]);
+      return 1;
+    }
+    if (mic.getSourceSampleRate() != SAMPLE_RATE)
+    {
+      printf("%s is %dHz, frequencies will be off by %.2fx\n", argv[1], mic.getSourceSampleRate(), (float)mic.getSourceSampleRate() / SAMPLE_RATE);
+    }
+  }
+  else
+  {
+    mic.generate(sine);
+  }
+
+  // audio analysis setup
+  audioInfo.setNoiseFloor(1); // sets the noise floor
+  vuMeter._inIsolation = true;
+  audioInfo.addFrequencyRange(&vuMeter);
+  audioInfo.addFrequencyRange(&bass);
+  audioInfo.addFrequencyRange(&mid);
+  audioInfo.addFrequencyRange(&high);
+
+  uint32_t frame = 0;
+  while (mic.read(samples) == SAMPLE_SIZE && (argc > 1 || frame < 100))
+  {
+    audioInfo.loop(samples, SAMPLE_SIZE, SAMPLE_RATE);
+    printf("frame: %6u, maxFrequency: %4d, ", ++frame, vuMeter.getMaxFrequency());
+    printf("vu: %6.2f, bass: %6.2f, mid: %6.2f, high: %6.2f\n", vuMeter.getValue(0, 255), bass.getValue(0, 255), mid.getValue(0, 255), high.getValue(0, 255));
+  }
+  return 0;
+}
@@ -0,0 +1,65 @@
+/*
+    Pipeline.ino
+    By Shea Ivey
+
+    Reads I2S microphone data and processes it into frequency buckets on core 0 while loop() on core 1
+    only prints the latest finished frame. Rendering never waits on the microphone or the FFT.
+    Use this as a starting point when a display or LED strip is too slow to run after every mic.read().
+*/
+
+#include <AudioInI2S.h>
+
+#define SAMPLE_SIZE 1024  // Buffer size of read samples
+#define SAMPLE_RATE 44100 // Audio Sample Rate
+#define HOP_SIZE 256      // new frame every 256 samples (5.8ms), 75% overlap
+
+#include <AudioFrequencyAnalysis.h>
+#include <AudioPipeline.h>
+AudioFrequencyAnalysis audioInfo;
+
+// ESP32 TTGO T-Display
+#define MIC_BCK_PIN 32            // Clock pin from the mic.
+#define MIC_WS_PIN 25             // WS pin from the mic.
+#define MIC_DATA_PIN 33           // SD pin data from the mic.
+#define MIC_CHANNEL_SELECT_PIN 27 // Left/Right pin to select the channel output from the mic.
+
+AudioInI2S mic(MIC_BCK_PIN, MIC_WS_PIN, MIC_DATA_PIN, MIC_CHANNEL_SELECT_PIN); // defaults to RIGHT channel.
+AudioPipeline pipeline(&mic, &audioInfo);
+
+FrequencyRange vuMeter(0, 20000);
+FrequencyRange bass(0, 249);
+FrequencyRange mid(250, 1499);
+FrequencyRange high(1500, 16000);
+
+void setup()
+{
+  Serial.begin(115200);
+  mic.begin(SAMPLE_SIZE, SAMPLE_RATE); // Starts the I2S DMA port.
+
+  // audio analysis setup
+  audioInfo.setNoiseFloor(1); // sets the noise floor
+  vuMeter._inIsolation = true;
+
+  // register the frequency ranges to audioInfo, index 0, 1, 2, 3 in the frame
+  audioInfo.addFrequencyRange(&vuMeter);
+  audioInfo.addFrequencyRange(&bass);
+  audioInfo.addFrequencyRange(&mid);
+  audioInfo.addFrequencyRange(&high);
+
+  // capture and analysis from here on happen on core 0, only read frames after this point.
+  pipeline.begin(SAMPLE_SIZE, SAMPLE_RATE, HOP_SIZE, 0);
+}
+
+void loop()
+{
+  if (!pipeline.available())
+  {
+    return; // nothing new to draw
+  }
+  const AudioFrame &frame = pipeline.read(); // never blocks
+
+  Serial.printf("frame: %6d, maxFrequency: %4d, ", frame.frame, frame.getMaxFrequency(0));
+  Serial.printf("vu: %6.2f, vuPeak: %6.2f, ", frame.getValue(0, 0, 255), frame.getPeak(0, 0, 255));
+  Serial.printf("bass: %6.2f, mid: %6.2f, high: %6.2f", frame.getValue(1, 0, 255), frame.getValue(2, 0, 255), frame.getValue(3, 0, 255));
+  Serial.println();
+}
@@ -0,0 +1,191 @@
+/*
+    BeatDetector.cpp
+    By Shea Ivey
+
+    Runs BeatDetector over the labelled click track tests/data/click128.wav (128 BPM, kick on
+    every beat, quiet hats between them, tests/data/click128.beats holds the beat times) and
+    checks the tempo and the beat times. The file is fed three ways: stream() with reads of one
+    hop, stream() with uneven reads like readAvailable() returns them, and loop().
+    Build and run from the library folder (tests/run.sh does it):
+      g++ -std=gnu++11 -O2 -I. tests/BeatDetector/BeatDetector.cpp -o beatdetector -lpthread
+      ./beatdetector
+*/
+
+#include <stdio.h>
+#include <AudioInI2S.h>
+
+#define SAMPLE_SIZE 512
+#define HOP_SIZE 128
+#define SAMPLE_RATE 11025
+#define RANGES 8
+#define MAX_BEATS 64
+#define SETTLE_SECONDS 3    // beats before this are not checked, the tempo is still being found
+#define BPM_TOLERANCE 0.02  // of the labelled tempo
+#define BEAT_TOLERANCE 0.05 // seconds
+
+#include <AudioFrequencyAnalysis.h>
+#include <BeatDetector.h>
+
+int failures = 0;
+
+#define CHECK(condition)                                            \
+  if (!(condition))                                                 \
+  {                                                                 \
+    printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+    failures++;                                                     \
+  }
+
+float labels[MAX_BEATS];
+int labelCount = 0;
+
+enum feed_type
+{
+  FEED_HOP,
+  FEED_UNEVEN,
+  FEED_LOOP
+};
+
+bool readLabels(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  while (labelCount < MAX_BEATS && fscanf(file, "%f", &labels[labelCount]) == 1)
+  {
+    labelCount++;
+  }
+  fclose(file);
+  return labelCount > 1;
+}
+
+int readSize(feed_type feed, uint32_t &seed)
+{
+  if (feed != FEED_UNEVEN)
+  {
+    return feed == FEED_HOP ? HOP_SIZE : SAMPLE_SIZE;
+  }
+  seed = seed * 1103515245 + 12345;
+  return 37 + (seed >> 16) % 364; // 37 - 400 samples, hops land wherever the reads end
+}
+
+void run(const char *name, feed_type feed)
+{
+  AudioInI2S mic;
+  mic.begin(SAMPLE_SIZE, SAMPLE_RATE);
+  mic.setRealtime(false);
+  if (!mic.openWav("tests/data/click128.wav"))
+  {
+    printf("can not read tests/data/click128.wav, run from the library folder\n");
+    failures++;
+    return;
+  }
+  AudioFrequencyAnalysisT<SAMPLE_SIZE, RANGES> *audioInfo = new AudioFrequencyAnalysisT<SAMPLE_SIZE, RANGES>();
+  BeatDetectorT<RANGES> *beat = new BeatDetectorT<RANGES>();
+  FrequencyRange *ranges[RANGES];
+  for (int r = 0; r < RANGES; r++)
+  {
+    float low = 40 * powf(100, (float)r / RANGES);
+    float high = 40 * powf(100, (float)(r + 1) / RANGES);
+    ranges[r] = new FrequencyRange(low, high - 1);
+    audioInfo->addFrequencyRange(ranges[r]);
+  }
+  audioInfo->setHopSize(HOP_SIZE);
+  beat->setLookAhead(-1);
+
+  float beats[MAX_BEATS];
+  int beatCount = 0;
+  uint32_t position = 0;
+  uint32_t seed = 1;
+  int32_t samples[SAMPLE_SIZE];
+  for (;;)
+  {
+    int length = readSize(feed, seed);
+    if (mic.read(samples, length) != length)
+    {
+      break;
+    }
+    position += length;
+    bool frame = true;
+    if (feed == FEED_LOOP)
+    {
+      audioInfo->loop(samples, SAMPLE_SIZE, SAMPLE_RATE);
+    }
+    else
+    {
+      frame = audioInfo->stream(samples, length, SAMPLE_SIZE, SAMPLE_RATE);
+    }
+    if (frame && beat->process(audioInfo) && beatCount < MAX_BEATS)
+    {
+      beats[beatCount++] = (float)position / SAMPLE_RATE; // when the newest sample arrived
+    }
+  }
+
+  // every beat after the tempo settled is on a label, and every label after it has a beat
+  float labelBpm = 60 * (labelCount - 1) / (labels[labelCount - 1] - labels[0]);
+  int checked = 0, onLabel = 0, labelled = 0, heard = 0;
+  for (int b = 0; b < beatCount; b++)
+  {
+    if (beats[b] < SETTLE_SECONDS)
+    {
+      continue;
+    }
+    checked++;
+    for (int l = 0; l < labelCount; l++)
+    {
+      if (fabsf(beats[b] - labels[l]) <= BEAT_TOLERANCE)
+      {
+        onLabel++;
+        break;
+      }
+    }
+  }
+  for (int l = 0; l < labelCount; l++)
+  {
+    if (labels[l] < SETTLE_SECONDS || labels[l] > (float)position / SAMPLE_RATE - BEAT_TOLERANCE)
+    {
+      continue;
+    }
+    labelled++;
+    for (int b = 0; b < beatCount; b++)
+    {
+      if (fabsf(beats[b] - labels[l]) <= BEAT_TOLERANCE)
+      {
+        heard++;
+        break;
+      }
+    }
+  }
+  printf("%s: bpm %.1f (labels %.1f), %d of %d beats on a label, %d of %d labels heard\n", name, beat->getBPM(), labelBpm, onLabel, checked, heard, labelled);
+  CHECK(fabsf(beat->getBPM() - labelBpm) <= BPM_TOLERANCE * labelBpm);
+  CHECK(beat->isLocked());
+  CHECK(checked > 0 && onLabel == checked);
+  CHECK(labelled > 0 && heard == labelled);
+
+  delete beat;
+  delete audioInfo;
+  for (int r = 0; r < RANGES; r++)
+  {
+    delete ranges[r];
+  }
+}
+
+int main()
+{
+  if (!readLabels("tests/data/click128.beats"))
+  {
+    printf("can not read tests/data/click128.beats, run from the library folder\n");
+    return 1;
+  }
+  run("stream, hop reads", FEED_HOP);
+  run("stream, uneven reads", FEED_UNEVEN);
+  run("loop", FEED_LOOP);
+  if (failures > 0)
+  {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("beat detector checks passed\n");
+  return 0;
+}
@@ -0,0 +1,222 @@
+/*
+    FixedPoint.cpp
+    By Shea Ivey
+
+    Compares the AUDIO_FIXED_POINT build of AudioAnalysis and AudioFrequencyAnalysis with the float build.
+    Both builds run the same generated signals and tests/data/chords.wav, the float build prints every band and
+    range value, the fixed point build reads them back and fails when a value above 1% of the largest value of its
+    frame is off by more than the documented tolerance.
+    Build and run from the library folder (tests/run.sh does all of it):
+      g++ -std=gnu++11 -O2 -I. tests/FixedPoint/FixedPoint.cpp -o fixedpoint_float -lpthread
+      g++ -std=gnu++11 -O2 -I. -DAUDIO_FIXED_POINT tests/FixedPoint/FixedPoint.cpp -o fixedpoint_fixed -lpthread
+      ./fixedpoint_float > float.txt
+      ./fixedpoint_fixed float.txt
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <AudioInI2S.h>
+
+#define SAMPLE_SIZE 1024
+#define SAMPLE_RATE 44100
+#define BAND_SIZE 16
+#define FRAMES 8             // frames per generated signal
+#define TOLERANCE 0.015      // documented in AudioAnalysis.md and AudioFrequencyAnalysis.md, -66dBFS included
+#define FLOOR 0.01           // values below 1% of the frame maximum are not compared
+
+#include <AudioAnalysis.h>
+#include <AudioFrequencyAnalysis.h>
+
+AudioAnalysis bandInfo;
+AudioFrequencyAnalysis rangeInfo;
+AudioInI2S mic; // no pins on the host
+int32_t samples[SAMPLE_SIZE];
+
+#define RANGES 21
+FrequencyRange *ranges[RANGES];
+
+std::map<std::string, float> reference; // float build values, only filled when comparing
+float worst = 0;
+int compared = 0;
+int failures = 0;
+
+float tone(uint32_t index, int sampleRate)
+{
+  return 0.5f * sin(TWO_PI * 1000.0 * index / sampleRate);
+}
+
+float bass(uint32_t index, int sampleRate)
+{
+  return 0.8f * sin(TWO_PI * 60.0 * index / sampleRate);
+}
+
+float chord(uint32_t index, int sampleRate)
+{
+  static const float hz[] = {261.63, 329.63, 392.0, 2093.0};
+  float v = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    v += 0.2f * sin(TWO_PI * hz[i] * index / sampleRate);
+  }
+  return v;
+}
+
+float noise(uint32_t index, int)
+{
+  // same numbers in both builds, rand() is not guaranteed to be
+  uint32_t x = index * 2654435761u + 12345;
+  x ^= x >> 15;
+  x *= 2246822519u;
+  x ^= x >> 13;
+  return 0.3f * ((float)(x & 0xFFFF) / 32768.0f - 1);
+}
+
+float quiet(uint32_t index, int sampleRate)
+{
+  return 0.001f * sin(TWO_PI * 440.0 * index / sampleRate); // -66dBFS, deep in the fixed point headroom
+}
+
+// one frame of values, compared against the float build when there is a reference
+void report(const char *signal, int frame, const char *analyzer, float *values, int length)
+{
+  float frameMax = 0;
+  for (int i = 0; i < length; i++)
+  {
+    frameMax = max(frameMax, values[i]);
+  }
+  for (int i = 0; i < length; i++)
+  {
+    char key[96];
+    snprintf(key, sizeof(key), "%s/%d/%s/%d", signal, frame, analyzer, i);
+    if (reference.empty())
+    {
+      printf("%s %.9g\n", key, values[i]);
+      continue;
+    }
+    std::map<std::string, float>::iterator expected = reference.find(key);
+    if (expected == reference.end())
+    {
+      printf("missing %s in the float build\n", key);
+      failures++;
+      continue;
+    }
+    if (expected->second < FLOOR * frameMax)
+    {
+      continue;
+    }
+    float error = fabs(values[i] - expected->second) / expected->second;
+    worst = max(worst, error);
+    compared++;
+    if (error > TOLERANCE)
+    {
+      printf("%s: fixed %.2f, float %.2f, %.1f%% off\n", key, values[i], expected->second, error * 100);
+      failures++;
+    }
+  }
+}
+
+void analyze(const char *signal, int frame)
+{
+  bandInfo.computeFFT(samples, SAMPLE_SIZE, SAMPLE_RATE);
+  bandInfo.computeFrequencies(BAND_SIZE);
+  report(signal, frame, "bands", bandInfo.getBands(), BAND_SIZE);
+
+  rangeInfo.loop(samples, SAMPLE_SIZE, SAMPLE_RATE);
+  float values[RANGES];
+  for (int r = 0; r < RANGES; r++)
+  {
+    values[r] = ranges[r]->getValue();
+  }
+  report(signal, frame, "ranges", values, RANGES);
+}
+
+void run(const char *signal, float (*generator)(uint32_t index, int sampleRate))
+{
+  mic.generate(generator);
+  for (int frame = 0; frame < FRAMES && mic.read(samples) == SAMPLE_SIZE; frame++)
+  {
+    analyze(signal, frame);
+  }
+}
+
+bool runWav(const char *path)
+{
+  if (!mic.openWav(path))
+  {
+    printf("can not read %s, run from the library folder\n", path);
+    return false;
+  }
+  for (int frame = 0; mic.read(samples) == SAMPLE_SIZE; frame++)
+  {
+    analyze("wav", frame);
+  }
+  return true;
+}
+
+bool readReference(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  if (file == nullptr)
+  {
+    printf("can not read %s\n", path);
+    return false;
+  }
+  char key[96];
+  float value;
+  while (fscanf(file, "%95s %f", key, &value) == 2)
+  {
+    reference[key] = value;
+  }
+  fclose(file);
+  return !reference.empty();
+}
+
+int main(int argc, char **argv)
+{
+  if (argc > 1 && !readReference(argv[1]))
+  {
+    return 1;
+  }
+  mic.begin(SAMPLE_SIZE, SAMPLE_RATE);
+  mic.setRealtime(false);
+
+  // raw values, no noise floor, normalizing or auto leveling between the builds
+  bandInfo.normalize(false);
+  bandInfo.setNoiseFloor(0);
+  rangeInfo.setNoiseFloor(0);
+  ranges[0] = new FrequencyRange(0, 20000);
+  ranges[1] = new FrequencyRange(0, 249);
+  ranges[2] = new FrequencyRange(250, 1499);
+  ranges[3] = new FrequencyRange(900, 1100);
+  ranges[4] = new FrequencyRange(1500, 16000);
+  for (int r = 5; r < RANGES; r++)
+  {
+    float low = 40 * powf(400, (float)(r - 5) / (RANGES - 5));
+    float high = 40 * powf(400, (float)(r - 4) / (RANGES - 5));
+    ranges[r] = new FrequencyRange(low, high - 1);
+  }
+  for (int r = 0; r < RANGES; r++)
+  {
+    rangeInfo.addFrequencyRange(ranges[r]);
+  }
+
+  run("tone", tone);
+  run("bass", bass);
+  run("chord", chord);
+  run("noise", noise);
+  run("quiet", quiet);
+  if (!runWav("tests/data/chords.wav"))
+  {
+    return 1;
+  }
+
+  if (reference.empty())
+  {
+    return 0; // float build, the values are the output
+  }
+  printf("%d values compared, worst %.2f%% off, tolerance %.1f%%\n", compared, worst * 100, TOLERANCE * 100);
+  return failures > 0 || compared == 0 ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+/*
+    FormatSwitch.cpp
+    By Shea Ivey
+
+    Counts heap allocations while the analyzer switches sample sizes after setup: with begin()
+    planning the sizes, constant-Q, calibration and frequency ranges of every width, a size
+    change must only pick prepared FFT plans, kernels and bin tables. The frame budget governor
+    stepping through sizes with constant-Q on must not allocate or rebuild kernels either.
+    Build and run from the library folder (tests/run.sh does it):
+      g++ -std=gnu++11 -O2 -I. tests/FormatSwitch/FormatSwitch.cpp -o formatswitch -lpthread
+      ./formatswitch
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <AudioInI2S.h>
+
+#define SAMPLE_SIZE 1024
+#define SAMPLE_RATE 44100
+
+#include <AudioFrequencyAnalysis.h>
+
+int failures = 0;
+int allocations = 0;
+
+#define CHECK(condition)                                            \
+  if (!(condition))                                                 \
+  {                                                                 \
+    printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+    failures++;                                                     \
+  }
+
+void *operator new(size_t size)
+{
+  allocations++;
+  void *p = malloc(size > 0 ? size : 1);
+  if (p == nullptr)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+  free(p);
+}
+
+int32_t samples[SAMPLE_SIZE];
+
+void fill(int sampleSize, int sampleRate)
+{
+  for (int i = 0; i < sampleSize; i++)
+  {
+    samples[i] = (int32_t)(0.3 * 2147483647.0 * sin(TWO_PI * 440.0 * i / sampleRate) + 0.2 * 2147483647.0 * sin(TWO_PI * 90.0 * i / sampleRate));
+  }
+}
+
+void constantQ(bool calibrated)
+{
+  AudioFrequencyAnalysis audioInfo;
+  FrequencyRange a4(427, 453), bass(60, 120), wide(500, 16000), full(0, 20000);
+  audioInfo.addFrequencyRange(&a4);
+  audioInfo.addFrequencyRange(&bass);
+  audioInfo.addFrequencyRange(&wide);
+  audioInfo.addFrequencyRange(&full);
+  audioInfo.begin(256);
+  audioInfo.setConstantQ(12, 55, 14080);
+  if (calibrated)
+  {
+    audioInfo.setCalibration(-26);
+  }
+  fill(SAMPLE_SIZE, SAMPLE_RATE);
+  audioInfo.loop(samples, SAMPLE_SIZE, SAMPLE_RATE); // first frame, range falloff averages and the like
+
+  int before = allocations;
+  static const int sizes[] = {256, 512, 1024, 512, 256, 1024};
+  for (int f = 0; f < 6; f++)
+  {
+    fill(sizes[f], SAMPLE_RATE);
+    for (int i = 0; i < 3; i++)
+    {
+      audioInfo.loop(samples, sizes[f], SAMPLE_RATE);
+    }
+    CHECK(audioInfo.isConstantQ());
+    CHECK(a4.getMaxFrequency() > 415 && a4.getMaxFrequency() < 466);
+  }
+  printf("constant-Q%s: %d allocations switching sizes\n", calibrated ? ", calibrated" : "", allocations - before);
+  CHECK(allocations == before);
+}
+
+void fftBins()
+{
+  // ranges grow past the entries of the first format when the bins get narrower
+  AudioFrequencyAnalysis audioInfo;
+  FrequencyRange wide(100, 15000), mid(1000, 4000);
+  audioInfo.addFrequencyRange(&wide);
+  audioInfo.addFrequencyRange(&mid);
+  audioInfo.begin(256);
+  fill(256, SAMPLE_RATE);
+  audioInfo.loop(samples, 256, SAMPLE_RATE);
+
+  int before = allocations;
+  fill(SAMPLE_SIZE, SAMPLE_RATE);
+  audioInfo.loop(samples, SAMPLE_SIZE, SAMPLE_RATE);
+  printf("FFT bins: %d allocations from 256 to 1024 samples\n", allocations - before);
+  CHECK(allocations == before);
+}
+
+void governor()
+{
+  // a budget no frame can meet, the governor steps down to the smallest size it may pick
+  AudioFrequencyAnalysis audioInfo;
+  FrequencyRange bass(60, 250), mid(250, 2000), high(2000, 8000); // would let the rate drop to 22050
+  audioInfo.addFrequencyRange(&bass);
+  audioInfo.addFrequencyRange(&mid);
+  audioInfo.addFrequencyRange(&high);
+  audioInfo.setConstantQ(12, 55, 14080);
+  audioInfo.setFrameBudget(1000000, 256);
+  fill(SAMPLE_SIZE, SAMPLE_RATE);
+  audioInfo.loop(samples, SAMPLE_SIZE, SAMPLE_RATE);
+
+  int before = allocations;
+  int smallest = SAMPLE_SIZE;
+  bool sameRate = true;
+  for (int f = 0; f < 200; f++)
+  {
+    int sampleSize = audioInfo.getGovernedSampleSize();
+    int sampleRate = audioInfo.getGovernedSampleRate();
+    fill(sampleSize, sampleRate);
+    audioInfo.loop(samples, sampleSize, sampleRate);
+    smallest = min(smallest, sampleSize);
+    sameRate = sameRate && sampleRate == SAMPLE_RATE;
+  }
+  printf("governor with constant-Q: %d allocations down to %d samples\n", allocations - before, smallest);
+  CHECK(smallest == 256);
+  CHECK(sameRate); // constant-Q keeps the rate the kernels were planned for
+  CHECK(audioInfo.isConstantQ());
+  CHECK(allocations == before);
+}
+
+int main()
+{
+  constantQ(false);
+  constantQ(true);
+  fftBins();
+  governor();
+  if (failures > 0)
+  {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("format switch checks passed\n");
+  return 0;
+}
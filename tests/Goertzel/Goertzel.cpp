@@ -0,0 +1,87 @@
+/*
+    Goertzel.cpp
+    By Shea Ivey
+
+    Checks GoertzelRange on a tone at its target frequency and on a tone away from it: off
+    target the value stays far below the on target value, and getMaxFrequency() reports the
+    target frequency either way, with or without the Hamming window and next to FFT ranges
+    or on its own.
+    Build and run from the library folder (tests/run.sh does it):
+      g++ -std=gnu++11 -O2 -I. tests/Goertzel/Goertzel.cpp -o goertzel -lpthread
+      ./goertzel
+*/
+
+#include <stdio.h>
+#include <AudioInI2S.h>
+
+#define SAMPLE_SIZE 1024
+#define SAMPLE_RATE 44100
+
+#include <AudioFrequencyAnalysis.h>
+
+int failures = 0;
+
+#define CHECK(condition)                                            \
+  if (!(condition))                                                 \
+  {                                                                 \
+    printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+    failures++;                                                     \
+  }
+
+int32_t samples[SAMPLE_SIZE];
+uint32_t sampleIndex = 0;
+
+void fill(float hz)
+{
+  for (int i = 0; i < SAMPLE_SIZE; i++, sampleIndex++)
+  {
+    samples[i] = (int32_t)(0.5 * 2147483647.0 * sin(TWO_PI * hz * sampleIndex / SAMPLE_RATE));
+  }
+}
+
+float tone(float hz, bool hamming, bool withFFT)
+{
+  // returns the detector value after a few blocks of the tone
+  AudioFrequencyAnalysis audioInfo;
+  GoertzelRange target(1000);
+  FrequencyRange around(950, 1050);
+  target._hamming = hamming;
+  audioInfo.addFrequencyRange(&target);
+  if (withFFT)
+  {
+    audioInfo.addFrequencyRange(&around);
+  }
+  CHECK(target.getMaxFrequency() == 1000); // known before the first block
+  sampleIndex = 0;
+  for (int frame = 0; frame < 8; frame++)
+  {
+    fill(hz);
+    audioInfo.loop(samples, SAMPLE_SIZE, SAMPLE_RATE);
+  }
+  CHECK(target.getMaxFrequency() == 1000); // the target, not a bin of the FFT
+  if (withFFT)
+  {
+    CHECK(around.getMaxFrequency() > 950 && around.getMaxFrequency() < 1050);
+  }
+  return target.getValue();
+}
+
+int main()
+{
+  for (int i = 0; i < 4; i++)
+  {
+    bool hamming = i & 1, withFFT = i & 2;
+    float on = tone(1000, hamming, withFFT);
+    float off = tone(3000, hamming, withFFT); // 46 FFT bins away
+    printf("%s%s: 1000Hz tone %8.1f, 3000Hz tone %6.1f\n", hamming ? "hamming" : "plain", withFFT ? " + FFT" : "", on, off);
+    CHECK(on > 1000);
+    CHECK(off < 0.05 * on);
+  }
+  if (failures > 0)
+  {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("goertzel checks passed\n");
+  return 0;
+}
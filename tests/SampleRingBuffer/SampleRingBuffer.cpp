@@ -0,0 +1,326 @@
+/*
+    SampleRingBuffer.cpp
+    By Shea Ivey
+
+    Checks SampleRingBuffer and the streaming functions of the host AudioInI2S:
+    wraparound, overrun counting when the ring is full, partial readAvailable() reads and
+    left/right interleaving in stereo. The producers are a thread writing a counter and the
+    host mic playing a generator or a stereo WAV written by the test. The source is also
+    changed while the stream thread runs, build with -fsanitize=thread to check for races.
+    Build and run from the library folder (tests/run.sh does it):
+      g++ -std=gnu++11 -O2 -I. tests/SampleRingBuffer/SampleRingBuffer.cpp -o ringbuffer -lpthread
+      ./ringbuffer
+*/
+
+#include <stdio.h>
+#include <AudioInI2S.h>
+
+int failures = 0;
+
+#define CHECK(condition)                                            \
+  if (!(condition))                                                 \
+  {                                                                 \
+    printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+    failures++;                                                     \
+  }
+
+void wraparound()
+{
+  SampleRingBuffer<int32_t> ring;
+  ring.begin(6);
+  CHECK(ring.capacity() == 8); // rounded up to a power of two
+
+  // chunks of 3 into 8 slots, every chunk after the second one crosses the end at a different offset
+  int32_t next = 0, expected = 0;
+  for (int i = 0; i < 50; i++)
+  {
+    int32_t chunk[3] = {next, next + 1, next + 2};
+    CHECK(ring.write(chunk, 3) == 3);
+    next += 3;
+    int32_t out[3] = {-1, -1, -1};
+    CHECK(ring.read(out, 3) == 3);
+    for (int j = 0; j < 3; j++)
+    {
+      CHECK(out[j] == expected++);
+    }
+  }
+  CHECK(ring.available() == 0);
+  CHECK(ring.getOverruns() == 0);
+}
+
+void overruns()
+{
+  SampleRingBuffer<int32_t> ring;
+  ring.begin(8);
+  int32_t chunk[5] = {1, 2, 3, 4, 5};
+  CHECK(ring.write(chunk, 5) == 5);
+  CHECK(ring.write(chunk, 5) == 0); // 3 free, the whole chunk is dropped
+  CHECK(ring.write(chunk, 5) == 0);
+  CHECK(ring.getOverruns() == 2);
+  CHECK(ring.available() == 5);     // what was written stays intact
+  CHECK(ring.write(chunk, 3) == 3); // exactly full is not an overrun
+  CHECK(ring.available() == 8);
+  CHECK(ring.getOverruns() == 2);
+
+  // partial reads take what is there and never more
+  int32_t out[16];
+  CHECK(ring.read(out, 6) == 6);
+  CHECK(out[0] == 1 && out[4] == 5 && out[5] == 1);
+  CHECK(ring.read(out, 16) == 2);
+  CHECK(out[0] == 2 && out[1] == 3);
+  CHECK(ring.read(out, 16) == 0);
+  CHECK(ring.skip(4) == 0);
+}
+
+void threaded()
+{
+  // a producer thread writing a counter against a consumer reading odd sized chunks, every value arrives once and in order
+  SampleRingBuffer<int32_t> ring;
+  ring.begin(64);
+  const int32_t total = 200000;
+  std::thread producer([&ring, total]()
+                       {
+                         int32_t next = 0;
+                         while (next < total)
+                         {
+                           int32_t chunk[7];
+                           int length = min(7, total - next);
+                           for (int i = 0; i < length; i++)
+                           {
+                             chunk[i] = next + i;
+                           }
+                           if ((int)ring.write(chunk, length) == length)
+                           {
+                             next += length;
+                           }
+                           else
+                           {
+                             std::this_thread::yield(); // counted as an overrun, try again
+                           }
+                         }
+                       });
+  int32_t expected = 0;
+  bool inOrder = true;
+  while (expected < total)
+  {
+    int32_t out[13];
+    int length = ring.read(out, 13);
+    for (int i = 0; i < length; i++)
+    {
+      inOrder = inOrder && out[i] == expected;
+      expected++;
+    }
+    if (length == 0)
+    {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  CHECK(inOrder);
+  CHECK(ring.available() == 0);
+}
+
+float ramp(uint32_t index, int)
+{
+  return (float)(index % 1000) / 1000.0f;
+}
+
+int32_t rampSample(uint32_t index)
+{
+  return (int32_t)(ramp(index, 0) * 2147483647.0); // what the host mic delivers for ramp()
+}
+
+void streamPartialReads()
+{
+  AudioInI2S mic;
+  mic.begin(256, 8000, I2S_NUM_0, 4, 64);
+  mic.setRealtime(false);
+  mic.generate(ramp);
+  CHECK(mic.beginStream(0, -1)); // polled, the ring holds 4 DMA buffers
+  CHECK(mic.available() == 256);
+
+  // odd sizes never line up with the 64 sample DMA buffers
+  int32_t samples[100];
+  uint32_t index = 0;
+  bool continuous = true;
+  for (int i = 0; i < 200; i++)
+  {
+    int length = mic.readAvailable(samples, 1 + i % 100);
+    CHECK(length > 0);
+    for (int j = 0; j < length; j++)
+    {
+      continuous = continuous && samples[j] == rampSample(index++);
+    }
+  }
+  CHECK(continuous);
+  CHECK(mic.getOverruns() == 0); // offline only makes buffers that fit
+}
+
+void streamOverruns()
+{
+  AudioInI2S mic;
+  mic.begin(64, 8000, I2S_NUM_0, 2, 64); // 2 buffers of 8ms
+  mic.generate(ramp);
+  CHECK(mic.beginStream(0, -1));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100)); // about 12 buffers come due, 2 fit
+  int queued = mic.available();
+  CHECK(queued == 128);
+  CHECK(mic.getOverruns() >= 5);
+
+  // the buffers that made it are still whole and in order
+  int32_t samples[128];
+  CHECK(mic.readAvailable(samples, 128) == 128);
+  bool continuous = true;
+  for (int j = 1; j < 128; j++)
+  {
+    continuous = continuous && samples[j] == rampSample(j);
+  }
+  CHECK(continuous);
+}
+
+bool writeStereoWav(const char *path, int frames)
+{
+  // 16 bit stereo, left counts up and right counts down so a swap or a shift shows
+  FILE *file = fopen(path, "wb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  uint32_t dataSize = frames * 4;
+  uint8_t header[44] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ', 16, 0, 0, 0,
+                        1, 0, 2, 0, 0x40, 0x1F, 0, 0, 0, 0x7D, 0, 0, 4, 0, 16, 0, 'd', 'a', 't', 'a'};
+  uint32_t riffSize = 36 + dataSize;
+  memcpy(&header[4], &riffSize, 4);
+  memcpy(&header[40], &dataSize, 4);
+  fwrite(header, 1, 44, file);
+  for (int i = 0; i < frames; i++)
+  {
+    int16_t frame[2] = {(int16_t)i, (int16_t)-i};
+    fwrite(frame, 2, 2, file);
+  }
+  fclose(file);
+  return true;
+}
+
+void streamStereo()
+{
+  const char *path = "/tmp/ringbuffer_stereo.wav";
+  const int frames = 3000;
+  CHECK(writeStereoWav(path, frames));
+  AudioInI2S mic(-1, -1, -1, -1, I2S_CHANNEL_FMT_RIGHT_LEFT);
+  mic.begin(128, 8000, I2S_NUM_0, 4, 50);
+  mic.setRealtime(false);
+  CHECK(mic.isStereo());
+  CHECK(mic.openWav(path));
+  CHECK(mic.beginStream(0, -1));
+  CHECK(mic.available() == 250); // per channel, 400 samples round up to 512 so 5 buffers of 50 pairs fit
+
+  int32_t left[77], right[77];
+  int index = 0;
+  bool interleaved = true;
+  for (int i = 0; index < frames; i++)
+  {
+    int length = mic.readAvailable(left, right, 1 + (i * 7) % 77);
+    if (length == 0)
+    {
+      break;
+    }
+    for (int j = 0; j < length; j++)
+    {
+      interleaved = interleaved && left[j] == (int32_t)((uint32_t)index << 16) && right[j] == (int32_t)((uint32_t)-index << 16);
+      index++;
+    }
+  }
+  CHECK(interleaved);
+  CHECK(index == frames);
+  CHECK(mic.getOverruns() == 0);
+  remove(path);
+}
+
+float half(uint32_t, int)
+{
+  return 0.5f;
+}
+
+void streamSourceChanges()
+{
+  // open, generate, close and re-pace the source while the stream thread is reading it
+  AudioInI2S mic;
+  mic.begin(64, 48000, I2S_NUM_0, 4, 64);
+  CHECK(mic.beginStream(0, 0));
+  int32_t samples[256];
+  CHECK(mic.read(samples, 64) == 0); // the stream thread owns the source
+  int32_t right[64];
+  CHECK(mic.read(samples, right, 64) == 0);
+  for (int i = 0; i < 200; i++)
+  {
+    switch (i % 5)
+    {
+    case 0:
+      CHECK(mic.openWav("tests/data/chords.wav", true));
+      break;
+    case 1:
+      mic.setRealtime(i % 2 == 0);
+      break;
+    case 2:
+      mic.generate(half);
+      break;
+    case 3:
+      CHECK(!mic.openWav("tests/data/missing.wav"));
+      break;
+    default:
+      mic.close();
+    }
+    mic.readAvailable(samples, 256);
+    std::this_thread::yield();
+  }
+
+  // once closed only silence arrives, after the generator samples that were queued before
+  mic.setRealtime(false);
+  mic.generate(half);
+  bool generated = false;
+  for (int i = 0; i < 1000 && !generated; i++)
+  {
+    int length = mic.readAvailable(samples, 256);
+    generated = length > 0 && samples[length - 1] == (int32_t)(0.5 * 2147483647.0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  CHECK(generated);
+  mic.close();
+  int silent = 0;
+  bool quiet = true;
+  for (int i = 0; i < 1000 && silent < 512; i++)
+  {
+    int length = mic.readAvailable(samples, 256);
+    for (int j = 0; j < length; j++)
+    {
+      quiet = quiet && (samples[j] == 0 || silent == 0); // nothing but silence once it started
+      silent += samples[j] == 0;
+    }
+    if (length == 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  CHECK(quiet);
+  CHECK(silent >= 512);
+  CHECK(!mic.isEnd());
+}
+
+int main()
+{
+  wraparound();
+  overruns();
+  threaded();
+  streamPartialReads();
+  streamOverruns();
+  streamStereo();
+  streamSourceChanges();
+  if (failures > 0)
+  {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("ring buffer and streaming checks passed\n");
+  return 0;
+}
@@ -0,0 +1,136 @@
+/*
+    Stereo.cpp
+    By Shea Ivey
+
+    Checks stereo analysis with setStereo(): a different tone on each channel through loop()
+    and stream() must only show up in the ranges of its own channel, and the right channel must
+    read exactly what a mono analyzer reads on the same samples, with a full AudioFrequencyAnalysis
+    or an AudioFrequencyAnalysisRight without FFT buffers as the right analyzer.
+    Build and run from the library folder (tests/run.sh does it):
+      g++ -std=gnu++11 -O2 -I. tests/Stereo/Stereo.cpp -o stereo -lpthread
+      ./stereo
+*/
+
+#include <stdio.h>
+#include <AudioInI2S.h>
+
+#define SAMPLE_SIZE 1024
+#define SAMPLE_RATE 44100
+#define HOP_SIZE 256
+
+#include <AudioFrequencyAnalysis.h>
+
+int failures = 0;
+
+#define CHECK(condition)                                            \
+  if (!(condition))                                                 \
+  {                                                                 \
+    printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+    failures++;                                                     \
+  }
+
+#define FRAMES 6
+
+int32_t left[SAMPLE_SIZE * FRAMES];
+int32_t right[SAMPLE_SIZE * FRAMES];
+
+void fill()
+{
+  for (int i = 0; i < SAMPLE_SIZE * FRAMES; i++)
+  {
+    left[i] = (int32_t)(0.5 * 2147483647.0 * sin(TWO_PI * 440.0 * i / SAMPLE_RATE));
+    right[i] = (int32_t)(0.3 * 2147483647.0 * sin(TWO_PI * 3000.0 * i / SAMPLE_RATE) + 0.1 * 2147483647.0 * sin(TWO_PI * 150.0 * i / SAMPLE_RATE));
+  }
+}
+
+// the same ranges on every channel
+struct Ranges
+{
+  FrequencyRange bass{100, 200}, a4{400, 480}, high{2800, 3200};
+  GoertzelRange tone{3000};
+
+  void add(AudioFrequencyAnalysisBase &audioInfo)
+  {
+    audioInfo.addFrequencyRange(&bass);
+    audioInfo.addFrequencyRange(&a4);
+    audioInfo.addFrequencyRange(&high);
+    audioInfo.addFrequencyRange(&tone);
+  }
+
+  bool same(Ranges &other)
+  {
+    return bass.getValue() == other.bass.getValue() && a4.getValue() == other.a4.getValue() && high.getValue() == other.high.getValue() &&
+           tone.getValue() == other.tone.getValue() && high.getMaxFrequency() == other.high.getMaxFrequency();
+  }
+};
+
+template <typename Right>
+void stereo(const char *name, bool streamed)
+{
+  AudioFrequencyAnalysis leftInfo, monoInfo;
+  Right rightInfo;
+  Ranges leftRanges, rightRanges, monoRanges;
+  leftInfo.setStereo(&rightInfo);
+  leftRanges.add(leftInfo);
+  rightRanges.add(rightInfo);
+  monoRanges.add(monoInfo);
+  CHECK(leftInfo.getRightChannel() == &rightInfo);
+
+  int frames = 0;
+  bool same = true;
+  if (streamed)
+  {
+    leftInfo.setHopSize(HOP_SIZE);
+    monoInfo.setHopSize(HOP_SIZE);
+    for (int i = 0; i + HOP_SIZE <= SAMPLE_SIZE * FRAMES; i += HOP_SIZE)
+    {
+      bool frame = leftInfo.stream(left + i, right + i, HOP_SIZE, SAMPLE_SIZE, SAMPLE_RATE);
+      CHECK(frame == monoInfo.stream(right + i, HOP_SIZE, SAMPLE_SIZE, SAMPLE_RATE));
+      frames += frame;
+      same = same && rightRanges.same(monoRanges);
+    }
+  }
+  else
+  {
+    for (int i = 0; i < FRAMES; i++)
+    {
+      leftInfo.loop(left + i * SAMPLE_SIZE, right + i * SAMPLE_SIZE, SAMPLE_SIZE, SAMPLE_RATE);
+      monoInfo.loop(right + i * SAMPLE_SIZE, SAMPLE_SIZE, SAMPLE_RATE);
+      frames++;
+      same = same && rightRanges.same(monoRanges);
+    }
+  }
+
+  printf("%s, %s: %d frames, left a4 %.0f high %.0f, right a4 %.0f high %.0f bass %.0f\n", name, streamed ? "stream()" : "loop()", frames,
+         leftRanges.a4.getValue(), leftRanges.high.getValue(), rightRanges.a4.getValue(), rightRanges.high.getValue(), rightRanges.bass.getValue());
+  CHECK(frames > 0);
+  CHECK(same); // the right channel reads what it would read on its own
+  // each tone stays on its own channel
+  CHECK(leftRanges.a4.getValue() > 100 * leftRanges.high.getValue());
+  CHECK(leftRanges.a4.getValue() > 100 * leftRanges.bass.getValue());
+  CHECK(leftRanges.a4.getMaxFrequency() > 420 && leftRanges.a4.getMaxFrequency() < 460);
+  CHECK(leftRanges.tone.getValue() < 0.02 * rightRanges.tone.getValue()); // unwindowed, a little of the loud 440Hz leaks in
+  CHECK(rightRanges.high.getValue() > 100 * rightRanges.a4.getValue());
+  CHECK(rightRanges.bass.getValue() > 100 * rightRanges.a4.getValue());
+  CHECK(rightRanges.high.getMaxFrequency() > 2950 && rightRanges.high.getMaxFrequency() < 3050);
+  // the left analyzer's FFT buffers hold the left channel after a frame
+  CHECK(leftInfo.getReal() == rightInfo.getReal());
+}
+
+int main()
+{
+  fill();
+  stereo<AudioFrequencyAnalysis>("AudioFrequencyAnalysis", false);
+  stereo<AudioFrequencyAnalysis>("AudioFrequencyAnalysis", true);
+  stereo<AudioFrequencyAnalysisRight>("AudioFrequencyAnalysisRight", false);
+  stereo<AudioFrequencyAnalysisRight>("AudioFrequencyAnalysisRight", true);
+  printf("AudioFrequencyAnalysis %d bytes, AudioFrequencyAnalysisRight %d bytes\n", (int)sizeof(AudioFrequencyAnalysis), (int)sizeof(AudioFrequencyAnalysisRight));
+  CHECK(sizeof(AudioFrequencyAnalysisRight) + (SAMPLE_SIZE + SAMPLE_SIZE / 2) * sizeof(fft_t) <= sizeof(AudioFrequencyAnalysis));
+  if (failures > 0)
+  {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("stereo checks passed\n");
+  return 0;
+}
@@ -0,0 +1,261 @@
+/*
+    TripleBuffer.cpp
+    By Shea Ivey
+
+    Checks the frame hand off between threads: a writer thread publishes numbered frames
+    through TripleBuffer while the reader swaps them in as fast as it can. Every frame the
+    reader sees must be whole (no words from two frames), never older than the last one it
+    saw, and never older than a frame the writer had finished publishing before update().
+    The same is checked on AudioPipeline with process() on a std::thread, and frames of
+    analyzers with more ranges than the default and of stereo analyzers arrive complete.
+    Build and run from the library folder (tests/run.sh does it):
+      g++ -std=gnu++11 -O2 -I. tests/TripleBuffer/TripleBuffer.cpp -o triplebuffer -lpthread
+      ./triplebuffer
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <AudioInI2S.h>
+
+#define SAMPLE_SIZE 256
+#define SAMPLE_RATE 44100
+#define BAND_SIZE 8
+
+#include <AudioPipeline.h>
+
+int failures = 0;
+
+#define CHECK(condition)                                            \
+  if (!(condition))                                                 \
+  {                                                                 \
+    printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+    failures++;                                                     \
+  }
+
+struct Frame
+{
+  uint32_t number = 0;
+  uint32_t words[512]; // large enough that a torn copy would be caught mid frame
+};
+
+void tripleBuffer()
+{
+  TripleBuffer<Frame> *buffer = new TripleBuffer<Frame>(); // 6KB, off the stack
+  TripleBuffer<Frame> &frames = *buffer;
+  const uint32_t total = 60000;
+  std::atomic<uint32_t> published{0}; // last frame number the writer finished publishing
+  std::thread writer([&frames, &published, total]()
+                     {
+                       for (uint32_t n = 1; n <= total; n++)
+                       {
+                         Frame &frame = frames.writeBuffer();
+                         frame.number = n;
+                         for (int i = 0; i < 512; i++)
+                         {
+                           frame.words[i] = n * 2654435761u + i; // every word belongs to exactly one frame
+                           if (n % 3 == 0 && i == (int)(n % 512))
+                           {
+                             std::this_thread::yield(); // lets the reader in with a half written frame, on a single core too
+                           }
+                         }
+                         frames.publish();
+                         published.store(n, std::memory_order_release);
+                       }
+                     });
+
+  uint32_t last = 0, swaps = 0, done = 0;
+  bool whole = true, newer = true, newest = true;
+  while (done < total) // one more look after the writer finished
+  {
+    done = published.load(std::memory_order_acquire);
+    bool swapped = frames.update();
+    const Frame &frame = frames.readBuffer();
+    for (int i = 0; i < 512 && frame.number > 0; i++) // 0 = nothing published yet
+    {
+      whole = whole && frame.words[i] == frame.number * 2654435761u + i;
+    }
+    newer = newer && (swapped ? frame.number > last : frame.number == last);
+    newest = newest && frame.number >= done; // a finished publish is never missed
+    last = frame.number;
+    swaps += swapped;
+    if (!swapped)
+    {
+      std::this_thread::yield();
+    }
+  }
+  writer.join();
+  CHECK(whole);
+  CHECK(newer);
+  CHECK(newest);
+  CHECK(last == total);
+  CHECK(!frames.update()); // nothing newer than the last frame
+  delete buffer;
+  printf("TripleBuffer: %u frames published, %u swapped in\n", total, swaps);
+}
+
+float tone(uint32_t index, int sampleRate)
+{
+  return 0.5f * sin(TWO_PI * 1000.0 * index / sampleRate);
+}
+
+void pipeline()
+{
+  AudioInI2S mic;
+  AudioFrequencyAnalysis audioInfo;
+  FrequencyRange low(0, 500), mid(501, 4000), high(4001, 16000);
+  audioInfo.addFrequencyRange(&low);
+  audioInfo.addFrequencyRange(&mid);
+  audioInfo.addFrequencyRange(&high);
+  mic.begin(SAMPLE_SIZE, SAMPLE_RATE);
+  mic.setRealtime(false);
+  mic.generate(tone);
+
+  AudioPipeline audioPipeline(&mic, &audioInfo);
+  CHECK(audioPipeline.begin(SAMPLE_SIZE, SAMPLE_RATE, 0, -1));
+  const uint32_t total = 2000; // no overlap, every process() publishes a frame
+  std::atomic<uint32_t> processed{0};
+  std::thread capture([&audioPipeline, &processed, total]()
+                      {
+                        for (uint32_t n = 1; n <= total; n++)
+                        {
+                          audioPipeline.process();
+                          processed.store(n, std::memory_order_release);
+                          std::this_thread::yield(); // the reader gets a look at most frames, on a single core too
+                        }
+                      });
+
+  uint32_t last = 0, seen = 0, done = 0;
+  bool whole = true, newer = true, newest = true;
+  while (done < total) // one more look after the capture finished
+  {
+    done = processed.load(std::memory_order_acquire);
+    const AudioFrame &frame = audioPipeline.read();
+    whole = whole && (frame.frame == 0 || (frame.rangesLength == 3 && frame.min <= frame.max)); // 0 = nothing published yet
+    newer = newer && frame.frame >= last;
+    newest = newest && frame.frame >= done;
+    seen += frame.frame != last;
+    if (frame.frame == last)
+    {
+      std::this_thread::yield();
+    }
+    last = frame.frame;
+  }
+  capture.join();
+  CHECK(whole);
+  CHECK(newer);
+  CHECK(newest);
+  CHECK(!audioPipeline.available());
+  CHECK(audioPipeline.read().frame == total);
+  CHECK(audioPipeline.read().getMaxFrequency(1) > 900 && audioPipeline.read().getMaxFrequency(1) < 1100);
+  printf("AudioPipeline: %u frames published, %u read\n", total, seen);
+}
+
+void manyRanges()
+{
+  // more ranges than BAND_SIZE + BAND_SIZE_PADDING, all of them reach the frame
+  AudioInI2S mic;
+  AudioFrequencyAnalysisT<SAMPLE_SIZE, 40> audioInfo;
+  FrequencyRange ranges[24] = {
+      {100, 600}, {600, 1100}, {1100, 1600}, {1600, 2100}, {2100, 2600}, {2600, 3100}, {3100, 3600}, {3600, 4100},
+      {4100, 4600}, {4600, 5100}, {5100, 5600}, {5600, 6100}, {6100, 6600}, {6600, 7100}, {7100, 7600}, {7600, 8100},
+      {8100, 8600}, {8600, 9100}, {9100, 9600}, {9600, 10100}, {10100, 10600}, {10600, 11100}, {11100, 11600}, {11600, 12100}};
+  for (int i = 0; i < 24; i++)
+  {
+    audioInfo.addFrequencyRange(&ranges[i]);
+  }
+  mic.begin(SAMPLE_SIZE, SAMPLE_RATE);
+  mic.setRealtime(false);
+  mic.generate(tone);
+  AudioPipelineT<40> audioPipeline(&mic, &audioInfo);
+  CHECK(audioPipeline.begin(SAMPLE_SIZE, SAMPLE_RATE, 0, -1));
+  for (int i = 0; i < 4; i++)
+  {
+    audioPipeline.process();
+  }
+  const AudioFrameT<40> &frame = audioPipeline.read();
+  CHECK(frame.rangesLength == 24);
+  CHECK(frame.getValue(1) > frame.getValue(23)); // the 1000Hz tone is in the second range
+  CHECK(frame.right.rangesLength == 0);
+  printf("AudioPipeline: %d ranges in a frame\n", frame.rangesLength);
+}
+
+bool writeStereoWav(const char *path, int frames, float leftHz, float rightHz)
+{
+  // 16 bit stereo at SAMPLE_RATE, a different tone on each channel
+  FILE *file = fopen(path, "wb");
+  if (file == nullptr)
+  {
+    return false;
+  }
+  uint32_t sampleRate = SAMPLE_RATE, byteRate = SAMPLE_RATE * 4, dataSize = frames * 4, riffSize = 36 + dataSize;
+  uint8_t header[44] = {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ', 16, 0, 0, 0,
+                        1, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 0, 16, 0, 'd', 'a', 't', 'a'};
+  memcpy(&header[4], &riffSize, 4);
+  memcpy(&header[24], &sampleRate, 4);
+  memcpy(&header[28], &byteRate, 4);
+  memcpy(&header[40], &dataSize, 4);
+  fwrite(header, 1, 44, file);
+  for (int i = 0; i < frames; i++)
+  {
+    int16_t frame[2] = {(int16_t)(16000 * sin(TWO_PI * leftHz * i / SAMPLE_RATE)), (int16_t)(16000 * sin(TWO_PI * rightHz * i / SAMPLE_RATE))};
+    fwrite(frame, 2, 2, file);
+  }
+  fclose(file);
+  return true;
+}
+
+void stereoPipeline()
+{
+  // the right channel of a stereo analyzer is published next to the left one
+  const char *path = "/tmp/triplebuffer_stereo.wav";
+  CHECK(writeStereoWav(path, SAMPLE_SIZE * 8, 1000, 6000));
+  AudioInI2S mono;
+  AudioInI2S mic(-1, -1, -1, -1, I2S_CHANNEL_FMT_RIGHT_LEFT);
+  AudioFrequencyAnalysis audioInfo, rightInfo;
+  FrequencyRange low(0, 500), mid(501, 4000), high(4001, 16000);
+  FrequencyRange rightLow(0, 500), rightMid(501, 4000), rightHigh(4001, 16000);
+  audioInfo.addFrequencyRange(&low);
+  audioInfo.addFrequencyRange(&mid);
+  audioInfo.addFrequencyRange(&high);
+  rightInfo.addFrequencyRange(&rightLow);
+  rightInfo.addFrequencyRange(&rightMid);
+  rightInfo.addFrequencyRange(&rightHigh);
+  audioInfo.setStereo(&rightInfo);
+
+  AudioPipeline monoPipeline(&mono, &audioInfo);
+  CHECK(!monoPipeline.begin(SAMPLE_SIZE, SAMPLE_RATE, 0, -1)); // a stereo analyzer needs both channels
+
+  mic.begin(SAMPLE_SIZE, SAMPLE_RATE);
+  mic.setRealtime(false);
+  CHECK(mic.openWav(path));
+  AudioPipeline audioPipeline(&mic, &audioInfo);
+  CHECK(audioPipeline.begin(SAMPLE_SIZE, SAMPLE_RATE, 0, -1));
+  for (int i = 0; i < 4; i++)
+  {
+    audioPipeline.process();
+  }
+  const AudioFrame &frame = audioPipeline.read();
+  CHECK(frame.frame == 4);
+  CHECK(frame.rangesLength == 3 && frame.right.rangesLength == 3);
+  CHECK(frame.getMaxFrequency(1) > 900 && frame.getMaxFrequency(1) < 1100);
+  CHECK(frame.right.getMaxFrequency(2) > 5900 && frame.right.getMaxFrequency(2) < 6100);
+  CHECK(frame.getValue(1) > frame.getValue(2));
+  CHECK(frame.right.getValue(2) > frame.right.getValue(1));
+  printf("AudioPipeline: stereo frame, left %dHz, right %dHz\n", frame.getMaxFrequency(1), frame.right.getMaxFrequency(2));
+  remove(path);
+}
+
+int main()
+{
+  tripleBuffer();
+  pipeline();
+  manyRanges();
+  stereoPipeline();
+  if (failures > 0)
+  {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("triple buffer checks passed\n");
+  return 0;
+}
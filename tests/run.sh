@@ -0,0 +1,47 @@
+#!/bin/sh
+# Builds and runs the host tests, run from the library folder: sh tests/run.sh
+# Exits with the first failure.
+set -e
+
+BUILD=${BUILD:-/tmp/audio-tests}
+CXX=${CXX:-g++}
+FLAGS="-std=gnu++11 -O2 -Wall -Wextra -I."
+mkdir -p "$BUILD"
+
+echo "FixedPoint"
+$CXX $FLAGS tests/FixedPoint/FixedPoint.cpp -o "$BUILD/fixedpoint_float" -lpthread
+$CXX $FLAGS -DAUDIO_FIXED_POINT tests/FixedPoint/FixedPoint.cpp -o "$BUILD/fixedpoint_fixed" -lpthread
+"$BUILD/fixedpoint_float" > "$BUILD/float.txt"
+"$BUILD/fixedpoint_fixed" "$BUILD/float.txt"
+
+echo "SampleRingBuffer"
+$CXX $FLAGS tests/SampleRingBuffer/SampleRingBuffer.cpp -o "$BUILD/ringbuffer" -lpthread
+"$BUILD/ringbuffer"
+
+echo "TripleBuffer"
+$CXX $FLAGS tests/TripleBuffer/TripleBuffer.cpp -o "$BUILD/triplebuffer" -lpthread
+"$BUILD/triplebuffer"
+
+echo "BeatDetector"
+$CXX $FLAGS tests/BeatDetector/BeatDetector.cpp -o "$BUILD/beatdetector" -lpthread
+"$BUILD/beatdetector"
+
+echo "FormatSwitch"
+$CXX $FLAGS tests/FormatSwitch/FormatSwitch.cpp -o "$BUILD/formatswitch" -lpthread
+$CXX $FLAGS -DAUDIO_FIXED_POINT tests/FormatSwitch/FormatSwitch.cpp -o "$BUILD/formatswitch_fixed" -lpthread
+"$BUILD/formatswitch"
+"$BUILD/formatswitch_fixed"
+
+echo "Goertzel"
+$CXX $FLAGS tests/Goertzel/Goertzel.cpp -o "$BUILD/goertzel" -lpthread
+$CXX $FLAGS -DAUDIO_FIXED_POINT tests/Goertzel/Goertzel.cpp -o "$BUILD/goertzel_fixed" -lpthread
+"$BUILD/goertzel"
+"$BUILD/goertzel_fixed"
+
+echo "Stereo"
+$CXX $FLAGS tests/Stereo/Stereo.cpp -o "$BUILD/stereo" -lpthread
+$CXX $FLAGS -DAUDIO_FIXED_POINT tests/Stereo/Stereo.cpp -o "$BUILD/stereo_fixed" -lpthread
+"$BUILD/stereo"
+"$BUILD/stereo_fixed"
+
+echo "all tests passed"